@@ -0,0 +1,52 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Import libraries (EddystoneBeacon depends on SPI)
+#include <SPI.h>
+#include <EddystoneBeacon.h>
+
+// define pins (varies per shield/board)
+//
+//   Adafruit Bluefruit LE   10, 2, 9
+//   Blend                    9, 8, UNUSED
+//   Blend Micro              6, 7, 4
+//   RBL BLE Shield           9, 8, UNUSED
+
+#define EDDYSTONE_BEACON_REQ   6
+#define EDDYSTONE_BEACON_RDY   7
+#define EDDYSTONE_BEACON_RST   4
+
+EddystoneBeacon eddystoneBeacon = EddystoneBeacon(EDDYSTONE_BEACON_REQ, EDDYSTONE_BEACON_RDY, EDDYSTONE_BEACON_RST);
+BLEUuid         uid             = BLEUuid("01020304050607080910-AABBCCDDEEFF"); // <namespace id>-<instance id>
+
+unsigned long   lastBatteryRead = 0;
+
+void setup() {
+  Serial.begin(9600);
+
+  eddystoneBeacon.setUID(uid);
+  eddystoneBeacon.setURI("http://www.example.com");
+
+  // 3 UID, 3 URL then 1 TLM frame, a new frame every second
+  eddystoneBeacon.setFrameRatio(EddystoneFrameUID, 3);
+  eddystoneBeacon.setFrameRatio(EddystoneFrameURL, 3);
+  eddystoneBeacon.setFrameRatio(EddystoneFrameTLM, 1);
+  eddystoneBeacon.setFrameInterval(1000);
+
+  eddystoneBeacon.begin(-18); // power
+
+  Serial.println(F("Eddystone Multi Frame Beacon"));
+}
+
+void loop() {
+  eddystoneBeacon.loop();
+
+  if (millis() - lastBatteryRead > 60000) {
+    // battery on A0 through a 1:2 divider, 3.3V reference
+    unsigned short batteryVoltage = analogRead(A0) * 2UL * 3300 / 1023;
+
+    eddystoneBeacon.setBatteryVoltage(batteryVoltage);
+
+    lastBatteryRead = millis();
+  }
+}
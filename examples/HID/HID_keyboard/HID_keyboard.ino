@@ -33,6 +33,8 @@ void setup() {
   bleHIDPeripheral.setLocalName("HID Keyboard");
   bleHIDPeripheral.addHID(bleKeyboard);
 
+  bleKeyboard.setLedEventHandler(keyboardLedsChanged);
+
   bleHIDPeripheral.begin();
 
   Serial.println(F("BLE HID Keyboard"));
@@ -46,15 +48,23 @@ void loop() {
     Serial.print(F("Connected to central: "));
     Serial.println(central.address());
 
+    // character still waiting for room in the report queue
+    int pending = -1;
+
     while (central.connected()) {
-      if (Serial.available() > 0) {
+      if (pending == -1 && Serial.available() > 0) {
         // read in character
         char c = Serial.read();
 
         Serial.print(F("c = "));
         Serial.println(c);
 
-        bleKeyboard.print(c);
+        pending = c;
+      }
+
+      // print returns 0 while the queue is full, try again on the next pass
+      if (pending != -1 && bleKeyboard.print((char)pending)) {
+        pending = -1;
       }
     }
 
@@ -63,3 +73,9 @@ void loop() {
     Serial.println(central.address());
   }
 }
+
+void keyboardLedsChanged(unsigned char leds) {
+  // host changed the lock keys
+  Serial.print(F("Caps lock: "));
+  Serial.println((leds & KB_LED_CAPS) ? F("on") : F("off"));
+}
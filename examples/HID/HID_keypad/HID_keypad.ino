@@ -61,12 +61,21 @@ void loop() {
     Serial.print(F("Connected to central: "));
     Serial.println(central.address());
 
+    // key still waiting for room in the report queue
+    char pending = 0;
+
     while (central.connected()) {
-      char c = keypad.getKey();
+      if (pending == 0) {
+        pending = keypad.getKey();
+
+        if (pending) {
+          Serial.println(pending);
+        }
+      }
 
-      if (c) {
-        Serial.println(c);
-        bleKeyboard.print(c);
+      // print returns 0 while the queue is full, try again on the next pass
+      if (pending && bleKeyboard.print(pending)) {
+        pending = 0;
       }
     }
 
@@ -0,0 +1,47 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "BLEArena.h"
+
+BLEArena::BLEArena(unsigned char* buffer, unsigned short size) :
+  _buffer(buffer),
+  _size(size),
+  _used(0),
+  _highWaterMark(0)
+{
+}
+
+void* BLEArena::allocate(size_t size) {
+  unsigned short end = this->_used + BLE_ARENA_ALIGN(size);
+
+  // track failed requests too, so the high water mark tells how big the arena needs to be
+  if (end > this->_highWaterMark) {
+    this->_highWaterMark = end;
+  }
+
+  if (end > this->_size) {
+    return NULL;
+  }
+
+  void* ptr = &this->_buffer[this->_used];
+
+  this->_used = end;
+
+  return ptr;
+}
+
+void BLEArena::reset() {
+  this->_used = 0;
+}
+
+unsigned short BLEArena::size() const {
+  return this->_size;
+}
+
+unsigned short BLEArena::used() const {
+  return this->_used;
+}
+
+unsigned short BLEArena::highWaterMark() const {
+  return this->_highWaterMark;
+}
@@ -0,0 +1,44 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef _BLE_ARENA_H_
+#define _BLE_ARENA_H_
+
+#include <stdlib.h>
+
+#define BLE_ARENA_ALIGN(size) (((size) + 3) & ~3)
+
+class BLEArena
+{
+  public:
+    BLEArena(unsigned char* buffer, unsigned short size);
+
+    void* allocate(size_t size);
+    void reset();
+
+    unsigned short size() const;
+    unsigned short used() const;
+    unsigned short highWaterMark() const;
+
+  private:
+    unsigned char*        _buffer;
+    unsigned short        _size;
+    unsigned short        _used;
+    unsigned short        _highWaterMark;
+};
+
+template<unsigned short SIZE> class BLEStaticArena : public BLEArena
+{
+  public:
+    BLEStaticArena();
+
+  private:
+    unsigned char         _arenaBuffer[SIZE] __attribute__ ((__aligned__(4)));
+};
+
+template<unsigned short SIZE> BLEStaticArena<SIZE>::BLEStaticArena() :
+  BLEArena(this->_arenaBuffer, SIZE)
+{
+}
+
+#endif
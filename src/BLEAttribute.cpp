@@ -5,7 +5,8 @@
 
 BLEAttribute::BLEAttribute(const char* uuid, enum BLEAttributeType type) :
   _uuid(uuid),
-  _type(type)
+  _type(type),
+  _deviceIndex(0xff)
 {
 }
 
@@ -21,6 +21,8 @@ enum BLEProperty {
 
 class BLEAttribute
 {
+  friend class BLEDevice;
+
   public:
     BLEAttribute(const char* uuid, enum BLEAttributeType type);
     const char* uuid() const;
@@ -30,6 +32,8 @@ class BLEAttribute
   private:
     const char*                 _uuid;
     enum BLEAttributeType       _type;
+
+    unsigned char               _deviceIndex;
 };
 
 #endif
@@ -8,6 +8,7 @@
   while (NRF_NVMC->READY == NVMC_READY_READY_Busy) {}; \
 }
 #elif defined(NRF51) || defined(NRF52)
+  #include <nrf_sdm.h>
   #include <nrf_soc.h>
 #else
   #warning "BLEBondStore persistent storage not supported on this platform"
@@ -17,20 +18,96 @@
 
 #include "BLEBondStore.h"
 
-BLEBondStore::BLEBondStore(int offset)
+#if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
+// the store is a log of records spread over a ring of flash pages, going down from the top of flash:
+//   page:   magic, sequence number, records...
+//   record: key, length << 16 | type << 8 | state, data padded to words
+// a record only counts once its state was cleared to committed, the last committed record of a key and type wins
+// and one without data removes it, a clear record drops everything before it. The type keeps the putData record
+// and clearing out of the key space of the bonds. The page after the active one is kept erased, when the active
+// page fills up the records still living in the oldest page are copied forward and that page is erased.
+#define BOND_PAGE_MAGIC                 0x53444e42
+#define BOND_PAGE_HEADER_WORDS          2
+#define BOND_RECORD_HEADER_WORDS        2
+#define BOND_RECORD_COMMITTED           0x00
+#define BOND_RECORD_LENGTH(info)        ((info) >> 16)
+#define BOND_RECORD_TYPE(info)          (((info) >> 8) & 0xff)
+#define BOND_RECORD_BOND                0xff
+#define BOND_RECORD_DATA                0xfe
+#define BOND_RECORD_CLEAR               0xfd
+#define BOND_RECORD_WORDS(length)       (BOND_RECORD_HEADER_WORDS + ((length) + 3) / 4)
+#define BOND_ERASED                     0xffffffff
+#define BOND_MAX_RETRIES                3
+
+#define BOND_ISSUE_DONE                 0
+#define BOND_ISSUE_PENDING              1
+#define BOND_ISSUE_BUSY                 2
+#define BOND_ISSUE_FAILED               3
+
+#define BOND_PAGE_WORDS                 (NRF_FICR->CODEPAGESIZE / 4)
+#endif
+
+#if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
+static bool pageValid(const uint32_t* page) {
+  return (page[0] == BOND_PAGE_MAGIC && page[1] != BOND_ERASED);
+}
+
+static bool pageBlank(const uint32_t* page) {
+  for (unsigned int i = 0; i < BOND_PAGE_WORDS; i++) {
+    if (page[i] != BOND_ERASED) {
+      return false;
+    }
+  }
+
+  return true;
+}
+#endif
+
+#if defined(NRF51) || defined(NRF52)
+static bool softdeviceEnabled() {
+  uint8_t enabled = 0;
+
+  sd_softdevice_is_enabled(&enabled);
+
+  return enabled;
+}
+#endif
+
+BLEBondStore::BLEBondStore(int offset, unsigned char numPages)
 #if defined(__AVR__) || defined(__MK20DX128__) || defined(__MK20DX256__) || defined(__MKL26Z64__)
-  : _offset(offset)
+  : _offset(offset),
+    _dirtyStart(0xffff),
+    _dirtyEnd(0)
 #elif defined(NRF51) || defined(NRF52) || defined(__RFduino__)
-  : _flashPageStartAddress((uint32_t *)(NRF_FICR->CODEPAGESIZE * (NRF_FICR->CODESIZE - 1 - (uint32_t)offset)))
+  : _numPages((numPages < 2) ? 2 : numPages),
+    _writable(true),
+    _loaded(false),
+    _recovering(false),
+    _legacyLength(0),
+    _activePage(0),
+    _activeSequence(0),
+    _writeAddress(NULL),
+    _numBonds(0),
+    _numJobs(0),
+    _numOperations(0),
+    _operationIndex(0),
+    _operationInFlight(false),
+    _operationRetries(0)
 #endif
 {
+#if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
+  // offset counts whole stores, store n takes the pages below the ones of store n - 1
+  this->_flashPageStartAddress = (uint32_t *)(NRF_FICR->CODEPAGESIZE * (NRF_FICR->CODESIZE - 1 - (uint32_t)offset * this->_numPages));
+#else
+  numPages = numPages;
+#endif
 }
 
 bool BLEBondStore::hasData() {
 #if defined(__AVR__) || defined(__MK20DX128__) || defined(__MK20DX256__) || defined(__MKL26Z64__)
   return (eeprom_read_byte((unsigned char *)this->_offset) == 0x01);
 #elif defined(NRF51) || defined(NRF52) || defined(__RFduino__)
-  return (*this->_flashPageStartAddress != 0xFFFFFFFF);
+  return (this->numBonds() > 0 || this->hasRecord(BOND_RECORD_DATA, 0));
 #else
   return false;
 #endif
@@ -38,90 +115,818 @@ bool BLEBondStore::hasData() {
 
 void BLEBondStore::clearData() {
 #if defined(__AVR__) || defined(__MK20DX128__) || defined(__MK20DX256__) || defined(__MKL26Z64__)
-  eeprom_write_byte((unsigned char *)this->_offset, 0x00);
-#elif defined(NRF51) || defined(NRF52)
-  int32_t pageNo = (uint32_t)_flashPageStartAddress / NRF_FICR->CODEPAGESIZE;
+  this->updateByte(this->_offset, 0x00);
+#elif defined(NRF51) || defined(NRF52) || defined(__RFduino__)
+  this->queueJob(BOND_RECORD_CLEAR, 0, NULL, 0);
+#endif
+}
 
-  while(sd_flash_page_erase(pageNo) == NRF_ERROR_BUSY);
-#elif defined(__RFduino__)
+void BLEBondStore::putData(const unsigned char* data, unsigned int offset, unsigned int length) {
+#if defined(__AVR__) || defined(__MK20DX128__) || defined(__MK20DX256__) || defined(__MKL26Z64__)
+  this->updateByte(this->_offset, 0x01);
 
-  // turn on flash erase enable
-  NRF_NVMC->CONFIG = (NVMC_CONFIG_WEN_Een << NVMC_CONFIG_WEN_Pos);
+  for (unsigned int i = 0; i < length; i++) {
+    unsigned int address = this->_offset + offset + i + 1;
 
-  // wait until ready
-  FLASH_WAIT_READY
+    // a write takes ~3.3 ms and wears the cell, most of the data is the same on every reconnect
+    if (eeprom_read_byte((unsigned char *)address) != data[i]) {
+      eeprom_write_byte((unsigned char *)address, data[i]);
 
-  // erase page
-  NRF_NVMC->ERASEPAGE = (uint32_t)this->_flashPageStartAddress;
+      if (offset + i < this->_dirtyStart) {
+        this->_dirtyStart = offset + i;
+      }
 
-  // wait until ready
-  FLASH_WAIT_READY
+      if (offset + i + 1 > this->_dirtyEnd) {
+        this->_dirtyEnd = offset + i + 1;
+      }
+    }
+  }
+#elif defined(NRF51) || defined(NRF52) || defined(__RFduino__) // ignores offset
+  offset = offset;
 
-  // turn off flash erase enable
-  NRF_NVMC->CONFIG = (NVMC_CONFIG_WEN_Ren << NVMC_CONFIG_WEN_Pos);
+  this->putRecord(BOND_RECORD_DATA, 0, data, length);
+#endif
+}
 
-  // wait until ready
-  FLASH_WAIT_READY
+void BLEBondStore::getData(unsigned char* data, unsigned int offset, unsigned int length) {
+#if defined(__AVR__) || defined(__MK20DX128__) || defined(__MK20DX256__) || defined(__MKL26Z64__)
+  for (unsigned int i = 0; i < length; i++) {
+    data[i] = eeprom_read_byte((unsigned char *)this->_offset + offset + i + 1);
+  }
+#elif defined(NRF51) || defined(NRF52) || defined(__RFduino__) // ignores offset
+  offset = offset;
+
+  this->getRecord(BOND_RECORD_DATA, 0, data, length);
 #endif
 }
 
-void BLEBondStore::putData(const unsigned char* data, unsigned int offset, unsigned int length) {
+bool BLEBondStore::hasBond(unsigned long key) {
+#if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
+  return this->hasRecord(BOND_RECORD_BOND, key);
+#else
+  key = key;
+
+  return false;
+#endif
+}
+
+bool BLEBondStore::putBond(unsigned long key, const unsigned char* data, unsigned int length) {
+#if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
+  return this->putRecord(BOND_RECORD_BOND, key, data, length);
+#else
+  key = key;
+  data = data;
+  length = length;
+
+  return false;
+#endif
+}
+
+bool BLEBondStore::getBond(unsigned long key, unsigned char* data, unsigned int length) {
+#if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
+  return this->getRecord(BOND_RECORD_BOND, key, data, length);
+#else
+  key = key;
+  data = data;
+  length = length;
+
+  return false;
+#endif
+}
+
+bool BLEBondStore::removeBond(unsigned long key) {
+#if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
+  if (!this->hasBond(key)) {
+    return false;
+  }
+
+  return this->queueJob(BOND_RECORD_BOND, key, NULL, 0);
+#else
+  key = key;
+
+  return false;
+#endif
+}
+
+bool BLEBondStore::dirtyRange(unsigned int& start, unsigned int& end) {
 #if defined(__AVR__) || defined(__MK20DX128__) || defined(__MK20DX256__) || defined(__MKL26Z64__)
-  eeprom_write_byte((unsigned char *)this->_offset, 0x01);
+  if (this->_dirtyStart >= this->_dirtyEnd) {
+    return false;
+  }
 
-  for (unsigned int i = 0; i < length; i++) {
-    eeprom_write_byte((unsigned char *)this->_offset + offset + i + 1, data[i]);
+  start = this->_dirtyStart;
+  end = this->_dirtyEnd;
+
+  this->_dirtyStart = 0xffff;
+  this->_dirtyEnd = 0;
+
+  return true;
+#else
+  start = start;
+  end = end;
+
+  return false;
+#endif
+}
+
+unsigned char BLEBondStore::numBonds() {
+#if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
+  unsigned char numBonds = 0;
+
+  if (!this->_loaded) {
+    this->load();
   }
-#elif defined(NRF51) || defined(NRF52)  // ignores offset
-  this->clearData();
 
-  while (sd_flash_write((uint32_t*)_flashPageStartAddress, (uint32_t*)data, (uint32_t)length/4) == NRF_ERROR_BUSY);
-#elif defined(__RFduino__) // ignores offset
-  this->clearData();
+  for (int i = 0; i < this->_numBonds; i++) {
+    if (BOND_RECORD_TYPE(this->_bonds[i].record[1]) == BOND_RECORD_BOND) {
+      numBonds++;
+    }
+  }
 
-  // turn on flash write enable
-  NRF_NVMC->CONFIG = (NVMC_CONFIG_WEN_Wen << NVMC_CONFIG_WEN_Pos);
+  return numBonds;
+#else
+  return this->hasData() ? 1 : 0;
+#endif
+}
 
-  // wait until ready
-  FLASH_WAIT_READY
 
-  uint32_t *out = this->_flashPageStartAddress;
-  uint32_t *in  = (uint32_t*)data;
+#if defined(__AVR__) || defined(__MK20DX128__) || defined(__MK20DX256__) || defined(__MKL26Z64__)
+void BLEBondStore::updateByte(unsigned int address, unsigned char value) {
+  if (eeprom_read_byte((unsigned char *)address) != value) {
+    eeprom_write_byte((unsigned char *)address, value);
+  }
+}
+#endif
+
+#if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
+uint32_t* BLEBondStore::pageAddress(unsigned char page) {
+  return this->_flashPageStartAddress - page * BOND_PAGE_WORDS;
+}
+
+bool BLEBondStore::hasRecord(unsigned char type, uint32_t key) {
+  if (!this->_loaded) {
+    this->load();
+  }
+
+  int job = this->findJob(type, key);
+
+  if (job != -1) {
+    return (this->_jobs[job].type != BOND_RECORD_CLEAR && this->_jobs[job].length);
+  }
+
+  if (type == BOND_RECORD_DATA && this->_legacyLength) {
+    return true;
+  }
+
+  return (this->findBond(type, key) != -1);
+}
+
+bool BLEBondStore::putRecord(unsigned char type, uint32_t key, const unsigned char* data, unsigned int length) {
+  if (length == 0 || length > BLE_BOND_STORE_DATA_SIZE) {
+    return false;
+  }
+
+  if (!this->_loaded) {
+    this->load();
+  }
+
+  int index = this->findBond(type, key);
+
+  if (index != -1 && this->findJob(type, key) == -1) {
+    const uint32_t* record = this->_bonds[index].record;
+
+    if (BOND_RECORD_LENGTH(record[1]) == length && memcmp(&record[BOND_RECORD_HEADER_WORDS], data, length) == 0) {
+      // unchanged, save the flash
+      return true;
+    }
+  }
+
+  return this->queueJob(type, key, data, length);
+}
+
+bool BLEBondStore::getRecord(unsigned char type, uint32_t key, unsigned char* data, unsigned int length) {
+  if (!this->_loaded) {
+    this->load();
+  }
+
+  int job = this->findJob(type, key);
+
+  if (job != -1) {
+    // not in flash yet
+    if (this->_jobs[job].type == BOND_RECORD_CLEAR || this->_jobs[job].length == 0) {
+      return false;
+    }
+
+    memcpy(data, this->_jobs[job].data, (length < this->_jobs[job].length) ? length : this->_jobs[job].length);
+
+    return true;
+  }
+
+  if (type == BOND_RECORD_DATA && this->_legacyLength) {
+    // not moved into the log yet
+    memcpy(data, this->pageAddress(0), (length < this->_legacyLength) ? length : this->_legacyLength);
+
+    return true;
+  }
+
+  int index = this->findBond(type, key);
+
+  if (index == -1) {
+    return false;
+  }
+
+  const uint32_t* record = this->_bonds[index].record;
+  unsigned int recordLength = BOND_RECORD_LENGTH(record[1]);
+
+  memcpy(data, &record[BOND_RECORD_HEADER_WORDS], (length < recordLength) ? length : recordLength);
+
+  return true;
+}
+
+void BLEBondStore::load() {
+  this->_loaded = true;
+  this->_numBonds = 0;
+  this->_writeAddress = NULL;
+
+  // replay the pages from the oldest to the newest, the newest one is the active page
+  uint32_t sequence = 0;
+
+  while (true) {
+    int next = -1;
+
+    for (unsigned char i = 0; i < this->_numPages; i++) {
+      uint32_t* page = this->pageAddress(i);
+
+      if (pageValid(page) && page[1] > sequence &&
+          (next == -1 || page[1] < this->pageAddress(next)[1])) {
+        next = i;
+      }
+    }
+
+    if (next == -1) {
+      break;
+    }
+
+    uint32_t* page = this->pageAddress(next);
+    uint32_t* pageEnd = page + BOND_PAGE_WORDS;
+    uint32_t* record = page + BOND_PAGE_HEADER_WORDS;
+
+    // the info word marks the end of the log, a key can be all ones
+    while (record + BOND_RECORD_HEADER_WORDS <= pageEnd && (record[0] != BOND_ERASED || record[1] != BOND_ERASED)) {
+      if (record[1] == BOND_ERASED) {
+        // header cut short, nothing more can go in this page
+        record = pageEnd;
+        break;
+      }
+
+      uint32_t* nextRecord = record + BOND_RECORD_WORDS(BOND_RECORD_LENGTH(record[1]));
+
+      if (nextRecord > pageEnd) {
+        record = pageEnd;
+        break;
+      }
+
+      if ((record[1] & 0xff) == BOND_RECORD_COMMITTED) {
+        this->indexRecord(record);
+      }
+
+      record = nextRecord;
+    }
+
+    sequence = page[1];
+
+    this->_activePage = next;
+    this->_activeSequence = sequence;
+    this->_writeAddress = (record < pageEnd) ? record : pageEnd;
+  }
+
+  bool formatted = (this->_writeAddress != NULL);
+
+  this->_writable = true;
+  this->_legacyLength = this->legacyLength(formatted);
+
+  if (!formatted) {
+    this->_activePage = this->_numPages - 1;
+    this->_activeSequence = 0;
+
+    // the first record starts page 0
+    this->_writeAddress = this->pageAddress(this->_activePage) + BOND_PAGE_WORDS;
+
+    // before the store wrote anything it can't tell a torn erase from data it doesn't own,
+    // it stays away from the pages instead of erasing them
+    for (unsigned char i = 1; i < this->_numPages; i++) {
+      uint32_t* page = this->pageAddress(i);
+
+      if (page[0] != BOND_PAGE_MAGIC && !pageBlank(page)) {
+#ifdef BLE_BOND_STORE_DEBUG
+        Serial.print(F("BLEBondStore: flash page "));
+        Serial.print((uint32_t)page / NRF_FICR->CODEPAGESIZE);
+        Serial.println(F(" holds other data, not writing"));
+#endif
+        this->_writable = false;
+        return;
+      }
+    }
+  }
+
+  // repairs cost flash time, they run from poll ahead of the jobs instead of blocking here
+  this->planRecovery();
+
+  this->_recovering = (this->_numOperations > 0);
+}
+
+unsigned short BLEBondStore::legacyLength(bool formatted) {
+  // the single page store kept its one bond unframed at the top of page 0
+  const uint32_t* legacyPage = this->pageAddress(0);
+
+  if (legacyPage[0] == BOND_PAGE_MAGIC || pageBlank(legacyPage)) {
+    return 0;
+  }
+
+  if (formatted) {
+    // migrating starts page 1 at sequence 1, which the ring never does otherwise, once the copy is
+    // committed anything left in page 0 is an erase that was cut short
+    const uint32_t* page = this->pageAddress(1);
+    const uint32_t* pageEnd = page + BOND_PAGE_WORDS;
+
+    if (!pageValid(page) || page[1] != 1) {
+      return 0;
+    }
+
+    for (const uint32_t* record = page + BOND_PAGE_HEADER_WORDS;
+          record + BOND_RECORD_HEADER_WORDS <= pageEnd && record[1] != BOND_ERASED;
+          record += BOND_RECORD_WORDS(BOND_RECORD_LENGTH(record[1]))) {
+      if ((record[1] & 0xff) == BOND_RECORD_COMMITTED && BOND_RECORD_TYPE(record[1]) == BOND_RECORD_DATA) {
+        return 0;
+      }
+    }
+  }
 
-  for(unsigned char i = 0; i < length; i += 4) { // assumes length is multiple of 4
-    *out = *in;
+  // up to the last word that was written
+  unsigned int words = BLE_BOND_STORE_DATA_SIZE / 4;
 
-    out++;
-    in++;
+  while (words && legacyPage[words - 1] == BOND_ERASED) {
+    words--;
   }
 
+  return words * 4;
+}
+
+void BLEBondStore::planRecovery() {
+  if (this->_legacyLength) {
+    this->planMigration();
+  }
+
+  unsigned char oldest = (this->_activePage + 1) % this->_numPages;
+
+  if (pageValid(this->pageAddress(oldest))) {
+    // a compaction was cut short, finish it
+    this->compact(oldest);
+  }
+
+  // erases that don't fit this time are planned again once the queue ran
+  for (unsigned char i = 0; i < this->_numPages; i++) {
+    uint32_t* page = this->pageAddress(i);
+
+    if (this->_legacyLength && i == 1) {
+      // the migration takes care of it
+      continue;
+    }
+
+    // pages with anything but a valid header were cut short while being erased or started,
+    // a magic without its sequence number is a header torn while being written
+    if (!pageValid(page) && !pageBlank(page)) {
+      this->queueOperation(FlashErase, page, NULL, 0);
+    }
+  }
+}
+
+void BLEBondStore::planMigration() {
+  uint32_t* page = this->pageAddress(1);
+
+  if (!pageValid(page) || this->_writeAddress + BOND_RECORD_WORDS(this->_legacyLength) > page + BOND_PAGE_WORDS) {
+    if (!pageBlank(page)) {
+      // nothing but earlier attempts, no other record is written before the migration is done
+      this->queueOperation(FlashErase, page, NULL, 0);
+    }
+
+    this->queueOperation(FlashWrite, page, NULL, BOND_PAGE_HEADER_WORDS * 4, BOND_PAGE_MAGIC, 1);
+
+    this->_activePage = 1;
+    this->_activeSequence = 1;
+    this->_writeAddress = page + BOND_PAGE_HEADER_WORDS;
+  }
+
+  // copied straight out of flash into the putData record, page 0 is erased after the copy is committed
+  this->append(BOND_RECORD_DATA, 0, (const unsigned char*)this->pageAddress(0), this->_legacyLength);
+}
+
+bool BLEBondStore::getLegacyBond(unsigned char* data, unsigned int length) {
+  return this->getRecord(BOND_RECORD_DATA, 0, data, length);
+}
+
+int BLEBondStore::findBond(unsigned char type, uint32_t key) {
+  for (int i = 0; i < this->_numBonds; i++) {
+    if (this->_bonds[i].key == key && BOND_RECORD_TYPE(this->_bonds[i].record[1]) == type) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+int BLEBondStore::findJob(unsigned char type, uint32_t key) {
+  // the newest update wins, clearing hides everything before it
+  for (int i = this->_numJobs - 1; i >= 0; i--) {
+    if ((this->_jobs[i].type == type && this->_jobs[i].key == key) || this->_jobs[i].type == BOND_RECORD_CLEAR) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+void BLEBondStore::indexRecord(const uint32_t* record) {
+  unsigned char type = BOND_RECORD_TYPE(record[1]);
+
+  if (type == BOND_RECORD_CLEAR) {
+    this->_numBonds = 0;
+    return;
+  }
+
+  int index = this->findBond(type, record[0]);
+
+  if (index != -1) {
+    this->removeIndexEntry(index);
+  }
+
+  if (BOND_RECORD_LENGTH(record[1]) == 0) {
+    // removed
+    return;
+  }
+
+  if (type == BOND_RECORD_BOND) {
+    int oldest = -1;
+    unsigned char numBonds = 0;
+
+    for (int i = 0; i < this->_numBonds; i++) {
+      if (BOND_RECORD_TYPE(this->_bonds[i].record[1]) == BOND_RECORD_BOND) {
+        if (oldest == -1) {
+          oldest = i;
+        }
+
+        numBonds++;
+      }
+    }
+
+    if (numBonds == BLE_BOND_STORE_MAX_BONDS) {
+      // full, the least recently stored bond makes room
+      this->removeIndexEntry(oldest);
+    }
+  }
+
+  this->_bonds[this->_numBonds].key = record[0];
+  this->_bonds[this->_numBonds].record = record;
+  this->_numBonds++;
+}
+
+void BLEBondStore::removeIndexEntry(int index) {
+  this->_numBonds--;
+  memmove(&this->_bonds[index], &this->_bonds[index + 1], sizeof(struct bondIndexEntry) * (this->_numBonds - index));
+}
+
+bool BLEBondStore::queueJob(unsigned char type, uint32_t key, const unsigned char* data, unsigned int length) {
+  if (!this->_loaded) {
+    this->load();
+  }
+
+  if (!this->_writable) {
+    return false;
+  }
+
+  // the first job is being written once it has operations, the others can still change
+  unsigned char firstWaiting = (this->_numOperations && !this->_recovering) ? 1 : 0;
+  struct bondJob* job;
+
+  if (type == BOND_RECORD_CLEAR) {
+    this->_numJobs = firstWaiting;
+  }
+
+  if (this->_numJobs > firstWaiting && this->_jobs[this->_numJobs - 1].type == type && this->_jobs[this->_numJobs - 1].key == key) {
+    job = &this->_jobs[this->_numJobs - 1];
+  } else if (this->_numJobs < BLE_BOND_STORE_QUEUE_SIZE) {
+    job = &this->_jobs[this->_numJobs++];
+  } else {
+    return false;
+  }
+
+  job->type = type;
+  job->key = key;
+  job->length = length;
+
+  if (length) {
+    memcpy(job->data, data, length);
+  }
+
+  this->processFlash();
+
+  return true;
+}
+
+void BLEBondStore::planJob() {
+  struct bondJob* job = &this->_jobs[0];
+
+  if (!this->_loaded) {
+    this->load();
+
+    if (this->_recovering || !this->_writable) {
+      return;
+    }
+  }
+
+  if (job->type == BOND_RECORD_CLEAR && this->_numBonds == 0) {
+    // nothing to drop, no flash to spend
+    return;
+  }
+
+  if (this->reserve(BOND_RECORD_WORDS(job->length))) {
+    this->append(job->type, job->key, job->data, job->length);
+  }
+}
+
+bool BLEBondStore::reserve(unsigned int words) {
+  if (this->_writeAddress + words <= this->pageAddress(this->_activePage) + BOND_PAGE_WORDS) {
+    return true;
+  }
+
+  if (words > BOND_PAGE_WORDS - BOND_PAGE_HEADER_WORDS) {
+    return false;
+  }
+
+  // start the next page of the ring, it was kept erased
+  unsigned char page = (this->_activePage + 1) % this->_numPages;
+
+  this->queueOperation(FlashWrite, this->pageAddress(page), NULL, BOND_PAGE_HEADER_WORDS * 4, BOND_PAGE_MAGIC, this->_activeSequence + 1);
+
+  this->_activePage = page;
+  this->_activeSequence++;
+  this->_writeAddress = this->pageAddress(page) + BOND_PAGE_HEADER_WORDS;
+
+  unsigned char oldest = (page + 1) % this->_numPages;
+
+  if (this->pageAddress(oldest)[0] != BOND_ERASED) {
+    this->compact(oldest);
+  }
+
+  return (this->_writeAddress + words <= this->pageAddress(page) + BOND_PAGE_WORDS);
+}
+
+void BLEBondStore::compact(unsigned char page) {
+  const uint32_t* pageStart = this->pageAddress(page);
+  const uint32_t* pageEnd = pageStart + BOND_PAGE_WORDS;
+  const uint32_t* activePageEnd = this->pageAddress(this->_activePage) + BOND_PAGE_WORDS;
+
+  // copied in index order, which is storing order, the copies take over when they are committed
+  for (int i = 0; i < this->_numBonds; i++) {
+    const uint32_t* record = this->_bonds[i].record;
+
+    if (record >= pageStart && record < pageEnd) {
+      unsigned int length = BOND_RECORD_LENGTH(record[1]);
+
+      // more bonds than a page holds lose the oldest ones with the erase
+      if (this->_writeAddress + BOND_RECORD_WORDS(length) <= activePageEnd) {
+        this->append(BOND_RECORD_TYPE(record[1]), record[0], (const unsigned char*)&record[BOND_RECORD_HEADER_WORDS], length);
+      }
+    }
+  }
+
+  this->queueOperation(FlashErase, this->pageAddress(page), NULL, 0);
+}
+
+void BLEBondStore::append(unsigned char type, uint32_t key, const unsigned char* data, unsigned int length) {
+  uint32_t* record = this->_writeAddress;
+
+  this->queueOperation(FlashWrite, record, NULL, BOND_RECORD_HEADER_WORDS * 4, key, (length << 16) | (type << 8) | 0xff);
+
+  if (length) {
+    this->queueOperation(FlashWrite, record + BOND_RECORD_HEADER_WORDS, data, length);
+  }
+
+  // a second write of the header word only clears bits
+  this->queueOperation(FlashCommit, record + 1, NULL, 4, (length << 16) | (type << 8) | BOND_RECORD_COMMITTED);
+
+  this->_writeAddress = record + BOND_RECORD_WORDS(length);
+}
+
+void BLEBondStore::queueOperation(enum flashOperationType type, uint32_t* address, const unsigned char* data, unsigned short length, uint32_t word0, uint32_t word1) {
+  if (this->_numOperations == BLE_BOND_STORE_MAX_OPERATIONS) {
+    return;
+  }
+
+  struct flashOperation* operation = &this->_operations[this->_numOperations++];
+
+  operation->type = type;
+  operation->address = address;
+  operation->data = data;
+  operation->length = length;
+  operation->words[0] = word0;
+  operation->words[1] = word1;
+}
+
+void BLEBondStore::processFlash() {
+  if (!this->_loaded) {
+    // repairs left over from the last recovery or an abandoned job are planned again
+    this->load();
+  }
+
+  while (!this->_operationInFlight) {
+    if (this->_operationIndex == this->_numOperations) {
+      if (this->_recovering) {
+        // replay the repaired pages, whatever didn't fit this time is planned again
+        this->_recovering = false;
+        this->_loaded = false;
+      } else if (this->_numOperations) {
+        // the first job made it to flash
+        this->popJob();
+      }
+
+      this->_numOperations = 0;
+      this->_operationIndex = 0;
+
+      if (this->_numJobs == 0) {
+        return;
+      }
+
+      this->planJob();
+
+      if (this->_numOperations == 0) {
+        // no room for it
+        this->popJob();
+      }
+
+      continue;
+    }
+
+    unsigned char result = this->issueOperation();
+
+    if (result == BOND_ISSUE_BUSY) {
+      // another flash operation is running, try again on the next poll
+      return;
+    } else if (result == BOND_ISSUE_PENDING) {
+      this->_operationInFlight = true;
+    } else if (result == BOND_ISSUE_DONE) {
+      this->completeOperation();
+    } else {
+      this->abandonJob();
+    }
+  }
+}
+
+bool BLEBondStore::flashEvent(uint32_t evtId) {
+#if defined(NRF51) || defined(NRF52)
+  if (!this->_operationInFlight ||
+      (evtId != NRF_EVT_FLASH_OPERATION_SUCCESS && evtId != NRF_EVT_FLASH_OPERATION_ERROR)) {
+    // someone else's
+    return false;
+  }
+
+  this->_operationInFlight = false;
+
+  if (evtId == NRF_EVT_FLASH_OPERATION_SUCCESS) {
+    this->completeOperation();
+  } else if (++this->_operationRetries > BOND_MAX_RETRIES) {
+    // the radio keeps the flash busy, give up on this job
+    this->abandonJob();
+  }
+
+  this->processFlash();
+
+  return true;
+#else
+  evtId = evtId;
+
+  return false;
+#endif
+}
+
+unsigned char BLEBondStore::issueOperation() {
+  struct flashOperation* operation = &this->_operations[this->_operationIndex];
+  unsigned int chunkLength = (operation->length < sizeof(this->_flashBuffer)) ? operation->length : sizeof(this->_flashBuffer);
+  unsigned int words = (chunkLength + 3) / 4;
+
+  if (operation->type != FlashErase) {
+    // through RAM, the data may be unaligned or in flash itself
+    memset(this->_flashBuffer, 0xff, sizeof(this->_flashBuffer));
+    memcpy(this->_flashBuffer, operation->data ? operation->data : (const unsigned char*)operation->words, chunkLength);
+  }
+
+#if defined(NRF51) || defined(NRF52)
+  uint32_t err;
+
+  if (operation->type == FlashErase) {
+    err = sd_flash_page_erase((uint32_t)operation->address / NRF_FICR->CODEPAGESIZE);
+  } else {
+    err = sd_flash_write(operation->address, this->_flashBuffer, words);
+  }
+
+  if (err == NRF_ERROR_BUSY) {
+    return BOND_ISSUE_BUSY;
+  } else if (err != NRF_SUCCESS) {
+    return BOND_ISSUE_FAILED;
+  }
+
+  // without the SoftDevice running the operation is already done and no event follows
+  return softdeviceEnabled() ? BOND_ISSUE_PENDING : BOND_ISSUE_DONE;
+#elif defined(__RFduino__)
+  // turn on flash erase or write enable
+  NRF_NVMC->CONFIG = (((operation->type == FlashErase) ? NVMC_CONFIG_WEN_Een : NVMC_CONFIG_WEN_Wen) << NVMC_CONFIG_WEN_Pos);
+
   // wait until ready
   FLASH_WAIT_READY
 
-  // turn off flash write enable
+  if (operation->type == FlashErase) {
+    NRF_NVMC->ERASEPAGE = (uint32_t)operation->address;
+
+    // wait until ready
+    FLASH_WAIT_READY
+  } else {
+    for (unsigned int i = 0; i < words; i++) {
+      operation->address[i] = this->_flashBuffer[i];
+
+      // wait until ready
+      FLASH_WAIT_READY
+    }
+  }
+
+  // turn off flash erase or write enable
   NRF_NVMC->CONFIG = (NVMC_CONFIG_WEN_Ren << NVMC_CONFIG_WEN_Pos);
 
   // wait until ready
   FLASH_WAIT_READY
+
+  return BOND_ISSUE_DONE;
 #endif
 }
 
-void BLEBondStore::getData(unsigned char* data, unsigned int offset, unsigned int length) {
-#if defined(__AVR__) || defined(__MK20DX128__) || defined(__MK20DX256__) || defined(__MKL26Z64__)
-  for (unsigned int i = 0; i < length; i++) {
-    data[i] = eeprom_read_byte((unsigned char *)this->_offset + offset + i + 1);
+void BLEBondStore::completeOperation() {
+  struct flashOperation* operation = &this->_operations[this->_operationIndex];
+
+  this->_operationRetries = 0;
+
+  if (operation->type == FlashErase) {
+    const uint32_t* pageEnd = operation->address + BOND_PAGE_WORDS;
+
+    // records that weren't copied out of the page are gone
+    for (int i = this->_numBonds - 1; i >= 0; i--) {
+      if (this->_bonds[i].record >= operation->address && this->_bonds[i].record < pageEnd) {
+        this->removeIndexEntry(i);
+      }
+    }
+
+    this->_operationIndex++;
+    return;
   }
-#elif defined(NRF51) || defined(NRF52) || defined(__RFduino__) // ignores offset
-  uint32_t *in = this->_flashPageStartAddress;
-  uint32_t *out  = (uint32_t*)data;
 
-  offset = offset;
+  unsigned int chunkLength = (operation->length < sizeof(this->_flashBuffer)) ? operation->length : sizeof(this->_flashBuffer);
 
-  for(unsigned int i = 0; i < length; i += 4) { // assumes length is multiple of 4
-    *out = *in;
+  operation->address += (chunkLength + 3) / 4;
+  operation->length -= chunkLength;
 
-    out++;
-    in++;
+  if (operation->data) {
+    operation->data += chunkLength;
   }
-#endif
+
+  if (operation->length) {
+    // next chunk
+    return;
+  }
+
+  if (operation->type == FlashCommit) {
+    // the record starts one word before its state
+    this->indexRecord(operation->address - 2);
+  }
+
+  this->_operationIndex++;
+}
+
+void BLEBondStore::abandonJob() {
+  this->_operationInFlight = false;
+  this->_operationRetries = 0;
+  this->_numOperations = 0;
+  this->_operationIndex = 0;
+
+  if (this->_recovering) {
+    this->_recovering = false;
+  } else {
+    this->popJob();
+  }
+
+  // replay whatever made it to flash on the next use, that only reads flash and plans the repairs again
+  this->_loaded = false;
 }
+
+void BLEBondStore::popJob() {
+  this->_numJobs--;
+  memmove(&this->_jobs[0], &this->_jobs[1], sizeof(struct bondJob) * this->_numJobs);
+}
+#endif
@@ -1,21 +1,132 @@
 #ifndef _BLE_BOND_STORE_H_
 #define _BLE_BOND_STORE_H_
 
+#include "Arduino.h"
+
+// bonds kept at once on nRF51/52, the index costs 8 bytes of RAM per bond
+#ifndef BLE_BOND_STORE_MAX_BONDS
+#define BLE_BOND_STORE_MAX_BONDS 4
+#endif
+
+// bond updates waiting to be written to flash on nRF51/52, each holds a copy of the bond data
+#ifndef BLE_BOND_STORE_QUEUE_SIZE
+#define BLE_BOND_STORE_QUEUE_SIZE 2
+#endif
+
+#ifndef BLE_BOND_STORE_DATA_SIZE
+#define BLE_BOND_STORE_DATA_SIZE 96
+#endif
+
+// worst case for one update: new page header, compaction of a full page including the putData record, the record itself
+#define BLE_BOND_STORE_MAX_OPERATIONS (3 * (BLE_BOND_STORE_MAX_BONDS + 1) + 5)
+
+class nRF51822;
+
 class BLEBondStore
 {
+  friend class nRF51822;
+
   public:
-    BLEBondStore(int offset = 0);
+    BLEBondStore(int offset = 0, unsigned char numPages = 2);
 
     bool hasData();
     void clearData();
     void putData(const unsigned char* data, unsigned int offset, unsigned int length);
     void getData(unsigned char* data, unsigned int offset, unsigned int length);
 
+    // multiple bonds looked up by a key the device derives from the peer, nRF51/52 only
+    bool hasBond(unsigned long key);
+    bool putBond(unsigned long key, const unsigned char* data, unsigned int length);
+    bool getBond(unsigned long key, unsigned char* data, unsigned int length);
+    bool removeBond(unsigned long key);
+    unsigned char numBonds();
+
+    // range of data bytes putData changed since the last call, EEPROM platforms only
+    bool dirtyRange(unsigned int& start, unsigned int& end);
+
   private:
 #if defined(__AVR__) || defined(__MK20DX128__) || defined(__MK20DX256__) || defined(__MKL26Z64__)
+    void updateByte(unsigned int address, unsigned char value);
+
     int             _offset;
+    unsigned int    _dirtyStart;
+    unsigned int    _dirtyEnd;
 #elif defined(NRF51)|| defined(NRF52) || defined(__RFduino__)
-    uint32_t*       _flashPageStartAddress;
+    enum flashOperationType {
+      FlashWrite,
+      FlashCommit,
+      FlashErase
+    };
+
+    struct bondIndexEntry {
+      uint32_t        key;
+      const uint32_t* record;
+    };
+
+    struct bondJob {
+      unsigned char   type;
+      uint32_t        key;
+      unsigned short  length;
+      unsigned char   data[BLE_BOND_STORE_DATA_SIZE];
+    };
+
+    struct flashOperation {
+      enum flashOperationType type;
+      uint32_t*               address;
+      const unsigned char*    data;
+      unsigned short          length;
+      uint32_t                words[2];
+    };
+
+    uint32_t* pageAddress(unsigned char page);
+    bool hasRecord(unsigned char type, uint32_t key);
+    bool putRecord(unsigned char type, uint32_t key, const unsigned char* data, unsigned int length);
+    bool getRecord(unsigned char type, uint32_t key, unsigned char* data, unsigned int length);
+    void load();
+    unsigned short legacyLength(bool formatted);
+    void planRecovery();
+    void planMigration();
+    bool getLegacyBond(unsigned char* data, unsigned int length);
+    int findBond(unsigned char type, uint32_t key);
+    int findJob(unsigned char type, uint32_t key);
+    void indexRecord(const uint32_t* record);
+    void removeIndexEntry(int index);
+    bool queueJob(unsigned char type, uint32_t key, const unsigned char* data, unsigned int length);
+    void planJob();
+    bool reserve(unsigned int words);
+    void compact(unsigned char page);
+    void append(unsigned char type, uint32_t key, const unsigned char* data, unsigned int length);
+    void queueOperation(enum flashOperationType type, uint32_t* address, const unsigned char* data, unsigned short length, uint32_t word0 = 0, uint32_t word1 = 0);
+    void processFlash();
+    bool flashEvent(uint32_t evtId);
+    unsigned char issueOperation();
+    void completeOperation();
+    void abandonJob();
+    void popJob();
+
+    uint32_t*                 _flashPageStartAddress;
+    unsigned char             _numPages;
+    bool                      _writable;
+    bool                      _loaded;
+    bool                      _recovering;
+    unsigned short            _legacyLength;
+    unsigned char             _activePage;
+    uint32_t                  _activeSequence;
+    uint32_t*                 _writeAddress;
+
+    // one more for the putData record
+    struct bondIndexEntry     _bonds[BLE_BOND_STORE_MAX_BONDS + 1];
+    unsigned char             _numBonds;
+
+    struct bondJob            _jobs[BLE_BOND_STORE_QUEUE_SIZE];
+    unsigned char             _numJobs;
+
+    struct flashOperation     _operations[BLE_BOND_STORE_MAX_OPERATIONS];
+    unsigned char             _numOperations;
+    unsigned char             _operationIndex;
+    bool                      _operationInFlight;
+    unsigned char             _operationRetries;
+    uint32_t                  _flashBuffer[8];
 #endif
 };
 
@@ -1,4 +1,5 @@
 #include "BLECentralRole.h"
+#include "BLEVendorUuidTable.h"
 #include "ble_hci.h"
 
 
@@ -178,33 +179,15 @@ uint32_t BLECentralRole::disconnect()
 void BLECentralRole::addRemoteAttribute(BLERemoteAttribute& attribute)
 {
 	BLEUuid uuid = BLEUuid(attribute.uuid());
-	const unsigned char *uuidData = uuid.data();
 
 	ble_uuid_t nordicUUID;
 
-	if (uuid.length() == 2)
-	{
-		nordicUUID.uuid = (uuidData[1] << 8) | uuidData[0];
-		nordicUUID.type = BLE_UUID_TYPE_BLE;
-	}
-	else
-	{
-		unsigned char uuidDataTemp[16];
-
-		memcpy(&uuidDataTemp, uuidData, sizeof(uuidDataTemp));
-
-		nordicUUID.uuid = (uuidData[13] << 8) | uuidData[12];
-
-		uuidDataTemp[13] = 0;
-		uuidDataTemp[12] = 0;
-
-		uint32_t res = sd_ble_uuid_vs_add((ble_uuid128_t *)&uuidDataTemp, &nordicUUID.type);
-		#if BLE_CENTRAL_ROLE_DEBUG
-		if(debug_handler != NULL){
-			debug_handler(BLE_DEBUG_OP_VS_UUID_ADD, res, NULL);
-		}
-		#endif
+	uint32_t res = BLEVendorUuidTable::resolve(uuid.data(), uuid.length(), &nordicUUID);
+	#if BLE_CENTRAL_ROLE_DEBUG
+	if(debug_handler != NULL && uuid.length() > 2){
+		debug_handler(BLE_DEBUG_OP_VS_UUID_ADD, res, NULL);
 	}
+	#endif
 
 	if(attribute.type() == BLETypeService){
 		_remoteServiceInfo[_numRemoteServices].service = (BLERemoteService *)&attribute;
@@ -221,6 +204,12 @@ void BLECentralRole::addRemoteAttribute(BLERemoteAttribute& attribute)
 }
 
 
+ble_uuid_t BLECentralRole::get_nordic_uuid(const char *uuid)
+{
+	return BLEUuid(uuid).get_nordic_uuid();
+}
+
+
 // Central Role methods
 bool BLECentralRole::begin()
 {
@@ -40,6 +40,19 @@ BLECharacteristic::BLECharacteristic(const char* uuid, unsigned char properties,
   this->setValue(value);
 }
 
+BLECharacteristic::BLECharacteristic(const char* uuid, unsigned char properties, unsigned char value[], unsigned char valueSize) :
+  BLELocalAttribute(uuid, BLETypeCharacteristic),
+  _valueSize(min(valueSize, BLE_ATTRIBUTE_MAX_VALUE_LENGTH)),
+  _value(value),
+  _valueLength(0),
+  _properties(properties),
+  _written(false),
+  _subscribed(false),
+  _listener(NULL)
+{
+  memset(this->_eventHandlers, 0x00, sizeof(this->_eventHandlers));
+}
+
 BLECharacteristic::~BLECharacteristic() {
   if (this->_value) {
     free(this->_value);
@@ -66,6 +79,10 @@ bool BLECharacteristic::fixedLength() const {
   return false;
 }
 
+bool BLECharacteristic::userLocated() const {
+  return false;
+}
+
 unsigned char BLECharacteristic::operator[] (int offset) const {
   return this->_value[offset];
 }
@@ -75,7 +92,9 @@ bool BLECharacteristic::setValue(const unsigned char value[], unsigned char leng
 
   this->_valueLength = min(length, this->_valueSize);
 
-  memcpy(this->_value, value, this->_valueLength);
+  if (value != this->_value) {
+    memcpy(this->_value, value, this->_valueLength);
+  }
 
   if (this->_listener) {
     success = this->_listener->characteristicValueChanged(*this);
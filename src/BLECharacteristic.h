@@ -44,6 +44,7 @@ class BLECharacteristic : public BLELocalAttribute
     virtual unsigned char operator[] (int offset) const;
 
     virtual bool fixedLength() const;
+    virtual bool userLocated() const;
 
     virtual bool setValue(const unsigned char value[], unsigned char length);
     virtual bool setValue(const char* value);
@@ -58,6 +59,9 @@ class BLECharacteristic : public BLELocalAttribute
     void setEventHandler(BLECharacteristicEvent event, BLECharacteristicEventHandler eventHandler);
 
   protected:
+    // value storage is supplied by the subclass and not freed
+    BLECharacteristic(const char* uuid, unsigned char properties, unsigned char value[], unsigned char valueSize);
+
     virtual void setValue(BLECentral& central, const unsigned char value[], unsigned char length);
     void setSubscribed(BLECentral& central, bool written);
 
@@ -14,7 +14,14 @@ BLEDevice::BLEDevice() :
   _maximumConnectionInterval(0),
   _connectable(DEFAULT_CONNECTABLE),
   _bondStore(NULL),
-  _eventListener(NULL)
+  _eventListener(NULL),
+  _arena(NULL),
+  _advertisingTimeout(0),
+  _sleepInterval(0),
+  _appLatency(0),
+  _appLatencyIdleTime(0),
+  _txBytes(0),
+  _txStartTime(0)
 {
 }
 
@@ -45,3 +52,63 @@ void BLEDevice::setConnectable(bool connectable) {
 void BLEDevice::setBondStore(BLEBondStore& bondStore) {
   this->_bondStore = &bondStore;
 }
+
+void BLEDevice::setArena(BLEArena* arena) {
+  this->_arena = arena;
+}
+
+void BLEDevice::setAdvertisingTimeout(unsigned short advertisingTimeout) {
+  this->_advertisingTimeout = advertisingTimeout;
+}
+
+void BLEDevice::setSleepInterval(unsigned long sleepInterval) {
+  this->_sleepInterval = sleepInterval;
+}
+
+void BLEDevice::setAppLatency(unsigned short appLatency, unsigned short appLatencyIdleTime) {
+  this->_appLatency = appLatency;
+  this->_appLatencyIdleTime = appLatencyIdleTime;
+}
+
+unsigned long BLEDevice::txThroughput() {
+  unsigned long elapsed = millis() - this->_txStartTime;
+
+  if (elapsed == 0) {
+    return 0;
+  }
+
+  // keep the multiplication from overflowing on long connections
+  if (this->_txBytes < (0xffffffffUL / 1000)) {
+    return (this->_txBytes * 1000) / elapsed;
+  }
+
+  return this->_txBytes / (elapsed / 1000);
+}
+
+void BLEDevice::resetTxThroughput() {
+  this->_txBytes = 0;
+  this->_txStartTime = millis();
+}
+
+void BLEDevice::addTxBytes(unsigned char length) {
+  this->_txBytes += length;
+}
+
+void* BLEDevice::allocate(size_t size) {
+  return (this->_arena) ? this->_arena->allocate(size) : malloc(size);
+}
+
+void BLEDevice::deallocate(void* ptr) {
+  // arena blocks are released all at once by resetting the arena
+  if (ptr && this->_arena == NULL) {
+    free(ptr);
+  }
+}
+
+unsigned char BLEDevice::attributeIndex(const BLEAttribute& attribute) {
+  return attribute._deviceIndex;
+}
+
+void BLEDevice::setAttributeIndex(BLEAttribute& attribute, unsigned char index) {
+  attribute._deviceIndex = index;
+}
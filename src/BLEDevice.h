@@ -4,6 +4,7 @@
 #ifndef _BLE_DEVICE_H_
 #define _BLE_DEVICE_H_
 
+#include "BLEArena.h"
 #include "BLEBondStore.h"
 #include "BLECharacteristic.h"
 #include "BLELocalAttribute.h"
@@ -21,6 +22,16 @@ struct BLEEirData
   unsigned char data[BLE_EIR_DATA_MAX_VALUE_LENGTH];
 };
 
+enum BLEPowerState {
+  BLEPowerStandby = 0,
+  BLEPowerAdvertising = 1,
+  BLEPowerConnected = 2,
+  BLEPowerAppLatency = 3,
+  BLEPowerSleep = 4
+};
+
+#define BLE_POWER_STATES 5
+
 class BLEDevice;
 
 class BLEDeviceEventListener
@@ -40,6 +51,7 @@ class BLEDeviceEventListener
     virtual void BLEDeviceAddressReceived(BLEDevice& /*device*/, const unsigned char* /*address*/) { }
     virtual void BLEDeviceTemperatureReceived(BLEDevice& /*device*/, float /*temperature*/) { }
     virtual void BLEDeviceBatteryLevelReceived(BLEDevice& /*device*/, float /*batteryLevel*/) { }
+    virtual void BLEDeviceSocEventReceived(BLEDevice& /*device*/, unsigned long /*evtId*/) { }
 };
 
 
@@ -58,6 +70,10 @@ class BLEDevice
     void setConnectionInterval(unsigned short minimumConnectionInterval, unsigned short maximumConnectionInterval);
     void setConnectable(bool connectable);
     void setBondStore(BLEBondStore& bondStore);
+    void setArena(BLEArena* arena);
+    void setAdvertisingTimeout(unsigned short advertisingTimeout);
+    void setSleepInterval(unsigned long sleepInterval);
+    void setAppLatency(unsigned short appLatency, unsigned short appLatencyIdleTime);
 
     virtual void begin(unsigned char /*advertisementDataSize*/,
                 BLEEirData * /*advertisementData*/,
@@ -96,6 +112,20 @@ class BLEDevice
     virtual void requestTemperature() { }
     virtual void requestBatteryLevel() { }
 
+    virtual unsigned long powerStateTime(BLEPowerState /*state*/) { return 0; }
+
+    void* allocate(size_t size);
+    void deallocate(void* ptr);
+
+    // notification/indication payload bytes per second since the connection started
+    unsigned long txThroughput();
+    void resetTxThroughput();
+    void addTxBytes(unsigned char length);
+
+    // slot for the device's own index of an attribute, it may be stale and must be validated before use
+    static unsigned char attributeIndex(const BLEAttribute& attribute);
+    static void setAttributeIndex(BLEAttribute& attribute, unsigned char index);
+
   protected:
     unsigned short                _advertisingInterval;
     unsigned short                _minimumConnectionInterval;
@@ -103,6 +133,15 @@ class BLEDevice
     bool                          _connectable;
     BLEBondStore*                 _bondStore;
     BLEDeviceEventListener*       _eventListener;
+    BLEArena*                     _arena;
+    unsigned short                _advertisingTimeout;
+    unsigned long                 _sleepInterval;
+    unsigned short                _appLatency;
+    unsigned short                _appLatencyIdleTime;
+
+  private:
+    unsigned long                 _txBytes;
+    unsigned long                 _txStartTime;
 };
 
 #endif
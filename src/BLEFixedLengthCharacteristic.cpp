@@ -14,6 +14,12 @@ BLEFixedLengthCharacteristic::BLEFixedLengthCharacteristic(const char* uuid, uns
 {
 }
 
+BLEFixedLengthCharacteristic::BLEFixedLengthCharacteristic(const char* uuid, unsigned char properties, unsigned char value[], unsigned char valueSize) :
+  BLECharacteristic(uuid, properties, value, valueSize)
+{
+  this->_valueLength = valueSize;
+}
+
 bool BLEFixedLengthCharacteristic::fixedLength() const {
   return true;
 }
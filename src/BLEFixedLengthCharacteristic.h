@@ -12,6 +12,9 @@ class BLEFixedLengthCharacteristic : public BLECharacteristic {
     BLEFixedLengthCharacteristic(const char* uuid, unsigned char properties, const char* value);
 
     virtual bool fixedLength() const;
+
+  protected:
+    BLEFixedLengthCharacteristic(const char* uuid, unsigned char properties, unsigned char value[], unsigned char valueSize);
 };
 
 #endif
@@ -0,0 +1,19 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "BLEGattDatabase.h"
+
+BLEGattStorage::BLEGattStorage(BLELocalAttribute** localAttributes, unsigned char maxLocalAttributes, unsigned char maxLocalCharacteristics,
+                                BLERemoteAttribute** remoteAttributes, unsigned char maxRemoteAttributes,
+                                unsigned char* deviceStorage, unsigned short deviceStorageSize) :
+  _localAttributes(localAttributes),
+  _maxLocalAttributes(maxLocalAttributes),
+  _maxLocalCharacteristics(maxLocalCharacteristics),
+  _numLocalCharacteristics(0),
+
+  _remoteAttributes(remoteAttributes),
+  _maxRemoteAttributes(maxRemoteAttributes),
+
+  _deviceArena(deviceStorage, deviceStorageSize)
+{
+}
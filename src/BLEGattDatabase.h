@@ -0,0 +1,70 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef _BLE_GATT_DATABASE_H_
+#define _BLE_GATT_DATABASE_H_
+
+#include "BLEArena.h"
+#include "BLELocalAttribute.h"
+#include "BLERemoteAttribute.h"
+
+#if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
+  #include "nRF51822.h"
+
+  #define BLE_DEVICE_STORAGE_SIZE(numLocalCharacteristics, numRemoteAttributes) nRF51822::storageSize(numLocalCharacteristics, numRemoteAttributes)
+#else
+  #include "nRF8001.h"
+
+  #define BLE_DEVICE_STORAGE_SIZE(numLocalCharacteristics, numRemoteAttributes) nRF8001::storageSize(numLocalCharacteristics, numRemoteAttributes)
+#endif
+
+// generic access + generic attribute services added by BLEPeripheral
+#define BLE_NUM_BUILT_IN_LOCAL_ATTRIBUTES       5
+#define BLE_NUM_BUILT_IN_LOCAL_CHARACTERISTICS  3
+#define BLE_NUM_BUILT_IN_REMOTE_ATTRIBUTES      2
+
+class BLEGattStorage
+{
+  friend class BLEPeripheral;
+
+  protected:
+    BLEGattStorage(BLELocalAttribute** localAttributes, unsigned char maxLocalAttributes, unsigned char maxLocalCharacteristics,
+                    BLERemoteAttribute** remoteAttributes, unsigned char maxRemoteAttributes,
+                    unsigned char* deviceStorage, unsigned short deviceStorageSize);
+
+  private:
+    BLELocalAttribute**         _localAttributes;
+    unsigned char               _maxLocalAttributes;
+    unsigned char               _maxLocalCharacteristics;
+    unsigned char               _numLocalCharacteristics;
+
+    BLERemoteAttribute**        _remoteAttributes;
+    unsigned char               _maxRemoteAttributes;
+
+    BLEArena                    _deviceArena;
+};
+
+// NUM_LOCAL_ATTRIBUTES, NUM_LOCAL_CHARACTERISTICS and NUM_REMOTE_ATTRIBUTES are the number of
+// attributes the sketch adds, built-in attributes are accounted for
+template<unsigned char NUM_LOCAL_ATTRIBUTES, unsigned char NUM_LOCAL_CHARACTERISTICS, unsigned char NUM_REMOTE_ATTRIBUTES = 0>
+class BLEGattDatabase : public BLEGattStorage
+{
+  public:
+    BLEGattDatabase();
+
+  private:
+    BLELocalAttribute*          _localAttributeBuffer[NUM_LOCAL_ATTRIBUTES + BLE_NUM_BUILT_IN_LOCAL_ATTRIBUTES];
+    BLERemoteAttribute*         _remoteAttributeBuffer[NUM_REMOTE_ATTRIBUTES + BLE_NUM_BUILT_IN_REMOTE_ATTRIBUTES];
+    unsigned char               _deviceStorageBuffer[BLE_DEVICE_STORAGE_SIZE(NUM_LOCAL_CHARACTERISTICS + BLE_NUM_BUILT_IN_LOCAL_CHARACTERISTICS,
+                                                      NUM_REMOTE_ATTRIBUTES + BLE_NUM_BUILT_IN_REMOTE_ATTRIBUTES)] __attribute__ ((__aligned__(4)));
+};
+
+template<unsigned char NUM_LOCAL_ATTRIBUTES, unsigned char NUM_LOCAL_CHARACTERISTICS, unsigned char NUM_REMOTE_ATTRIBUTES>
+BLEGattDatabase<NUM_LOCAL_ATTRIBUTES, NUM_LOCAL_CHARACTERISTICS, NUM_REMOTE_ATTRIBUTES>::BLEGattDatabase() :
+  BLEGattStorage(this->_localAttributeBuffer, sizeof(this->_localAttributeBuffer) / sizeof(BLELocalAttribute*), NUM_LOCAL_CHARACTERISTICS,
+                  this->_remoteAttributeBuffer, sizeof(this->_remoteAttributeBuffer) / sizeof(BLERemoteAttribute*),
+                  this->_deviceStorageBuffer, sizeof(this->_deviceStorageBuffer))
+{
+}
+
+#endif
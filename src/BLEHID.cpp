@@ -36,11 +36,23 @@ unsigned char BLEHID::numHids() {
   return _numHids;
 }
 
-void BLEHID::sendData(BLECharacteristic& characteristic, unsigned char data[], unsigned char length) {
-  // wait until we can notify
-  while(!characteristic.canNotify()) {
-    BLEHIDPeripheral::instance()->poll();
-  }
+bool BLEHID::connected() {
+  return BLEHIDPeripheral::instance()->_connected;
+}
+
+bool BLEHID::bootProtocol() {
+  return BLEHIDPeripheral::instance()->bootProtocol();
+}
+
+bool BLEHID::canSendData(unsigned char numReports) {
+  return (BLEHIDPeripheral::instance()->reportQueueAvailable() >= numReports);
+}
+
+unsigned char BLEHID::reportQueueAvailable() {
+  return BLEHIDPeripheral::instance()->reportQueueAvailable();
+}
 
-  characteristic.setValue(data, length);
+bool BLEHID::sendData(BLECharacteristic& characteristic, unsigned char data[], unsigned char length) {
+  // queued and sent from poll(), false if disconnected or the queue is full
+  return BLEHIDPeripheral::instance()->queueReport(characteristic, data, length);
 }
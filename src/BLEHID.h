@@ -7,6 +7,9 @@
 #include "BLELocalAttribute.h"
 #include "BLECharacteristic.h"
 
+#define BLE_HID_PROTOCOL_MODE_BOOT    0x00
+#define BLE_HID_PROTOCOL_MODE_REPORT  0x01
+
 class BLEHID
 {
   friend class BLEHIDPeripheral;
@@ -20,9 +23,14 @@ class BLEHID
   protected:
     static unsigned char numHids();
 
-    void sendData(BLECharacteristic& characteristic, unsigned char data[], unsigned char dataLength);
+    bool connected();
+    bool bootProtocol();
+    bool canSendData(unsigned char numReports);
+    unsigned char reportQueueAvailable();
+    bool sendData(BLECharacteristic& characteristic, unsigned char data[], unsigned char dataLength);
 
     virtual void setReportId(unsigned char reportId);
+    virtual void poll() { }
     virtual unsigned char numAttributes() { return 0; }
     virtual BLELocalAttribute** attributes() { return 0; }
 
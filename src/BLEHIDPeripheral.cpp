@@ -15,19 +15,28 @@ BLEHIDPeripheral::BLEHIDPeripheral(unsigned char req, unsigned char rdy, unsigne
   _hidReportMapCharacteristic(),
   _hidInformationCharacteristic("2a4a", hidInformationCharacteriticValue, sizeof(hidInformationCharacteriticValue)),
   _hidControlPointCharacteristic("2a4c", BLEWriteWithoutResponse),
+  _hidProtocolModeCharacteristic("2a4e", BLERead | BLEWriteWithoutResponse),
 
   _reportIdOffset(0),
+  _reportMap(NULL),
+  _reportMapLength(0),
+  _builtReportMap(NULL),
 
   _hids(NULL),
-  _numHids(0)
+  _numHids(0),
+
+  _connected(false),
+  _reportHead(0),
+  _numReports(0)
 {
   _instance = this;
+
+  this->_hidProtocolModeCharacteristic.setValue(BLE_HID_PROTOCOL_MODE_REPORT);
 }
 
 BLEHIDPeripheral::~BLEHIDPeripheral() {
-  if (this->_hids) {
-    free(this->_hids);
-  }
+  this->deallocate(this->_hids);
+  this->deallocate(this->_builtReportMap);
 }
 
 BLEHIDPeripheral* BLEHIDPeripheral::instance() {
@@ -42,6 +51,7 @@ void BLEHIDPeripheral::begin() {
   this->addAttribute(this->_hidService);
   this->addAttribute(this->_hidInformationCharacteristic);
   this->addAttribute(this->_hidControlPointCharacteristic);
+  this->addAttribute(this->_hidProtocolModeCharacteristic);
   this->addAttribute(this->_hidReportMapCharacteristic);
 
   for (int i = 0; i < this->_numHids; i++) {
@@ -55,12 +65,29 @@ void BLEHIDPeripheral::begin() {
     }
   }
 
-  this->_hidReportMapCharacteristic.setHids(this->_hids, this->_numHids);
+  if (this->_reportMap) {
+    this->_hidReportMapCharacteristic.setReportMap(this->_reportMap, this->_reportMapLength, true);
+  } else {
+    this->buildReportMap();
+  }
 
   // begin initialization
   BLEPeripheral::begin();
 }
 
+void BLEHIDPeripheral::end() {
+  BLEPeripheral::end();
+
+  this->deallocate(this->_builtReportMap);
+  this->_builtReportMap = NULL;
+
+  if (this->arena()) {
+    // HID table was released with the arena, HIDs must be added again before the next begin
+    this->_hids = NULL;
+    this->_numHids = 0;
+  }
+}
+
 void BLEHIDPeripheral::clearBondStoreData() {
   this->_bleBondStore.clearData();
 }
@@ -69,13 +96,18 @@ void BLEHIDPeripheral::setReportIdOffset(unsigned char reportIdOffset) {
   this->_reportIdOffset = reportIdOffset;
 }
 
-void BLEHIDPeripheral::poll() {
-  BLEPeripheral::poll();
+void BLEHIDPeripheral::setReportMap(const unsigned char reportMap[], unsigned char length) {
+  this->_reportMap = reportMap;
+  this->_reportMapLength = length;
 }
 
 void BLEHIDPeripheral::addHID(BLEHID& hid) {
   if (this->_hids == NULL) {
-    this->_hids = (BLEHID**)malloc(sizeof(BLEHID*) * BLEHID::numHids());
+    this->_hids = (BLEHID**)this->allocate(sizeof(BLEHID*) * BLEHID::numHids());
+
+    if (this->_hids == NULL) {
+      return;
+    }
   }
 
   hid.setReportId(this->_numHids + this->_reportIdOffset);
@@ -83,3 +115,118 @@ void BLEHIDPeripheral::addHID(BLEHID& hid) {
   this->_hids[this->_numHids] = &hid;
   this->_numHids++;
 }
+
+void BLEHIDPeripheral::buildReportMap() {
+  // report IDs are known once all HIDs are added, patch them in one pass
+  // instead of walking the HIDs for every byte the radio asks for
+  unsigned char length = 0;
+
+  for (int i = 0; i < this->_numHids; i++) {
+    length += this->_hids[i]->getDescriptorLength();
+  }
+
+  this->deallocate(this->_builtReportMap);
+  this->_builtReportMap = (unsigned char*)this->allocate(length);
+
+  if (this->_builtReportMap == NULL) {
+    length = 0;
+  }
+
+  unsigned char offset = 0;
+
+  for (int i = 0; i < this->_numHids && offset < length; i++) {
+    BLEHID *hid = this->_hids[i];
+    unsigned char descriptorLength = hid->getDescriptorLength();
+
+    for (unsigned char j = 0; j < descriptorLength; j++) {
+      this->_builtReportMap[offset++] = hid->getDescriptorValueAtOffset(j);
+    }
+  }
+
+  this->_hidReportMapCharacteristic.setReportMap(this->_builtReportMap, length, false);
+}
+
+bool BLEHIDPeripheral::bootProtocol() {
+  return (this->_hidProtocolModeCharacteristic.value() == BLE_HID_PROTOCOL_MODE_BOOT);
+}
+
+unsigned char BLEHIDPeripheral::pendingReports() {
+  return this->_numReports;
+}
+
+unsigned char BLEHIDPeripheral::reportQueueAvailable() {
+  return (this->_connected) ? (BLE_HID_REPORT_QUEUE_SIZE - this->_numReports) : 0;
+}
+
+bool BLEHIDPeripheral::queueReport(BLECharacteristic& characteristic, const unsigned char data[], unsigned char length) {
+  if (!this->_connected || length > BLE_HID_REPORT_MAX_LENGTH) {
+    return false;
+  }
+
+  // nothing ahead of it, skip the copy
+  if (this->_numReports == 0 && characteristic.canNotify()) {
+    return characteristic.setValue(data, length);
+  }
+
+  if (this->_numReports == BLE_HID_REPORT_QUEUE_SIZE) {
+    // full, the caller decides whether to retry after poll() or give up
+    return false;
+  }
+
+  struct report* report = &this->_reports[(this->_reportHead + this->_numReports) % BLE_HID_REPORT_QUEUE_SIZE];
+
+  report->characteristic = &characteristic;
+  report->length = length;
+  memcpy(report->data, data, length);
+
+  this->_numReports++;
+
+  return true;
+}
+
+void BLEHIDPeripheral::sendReports() {
+  // one report per free TX buffer, in the order they were queued
+  while (this->_numReports) {
+    struct report* report = &this->_reports[this->_reportHead];
+
+    if (!report->characteristic->canNotify()) {
+      break;
+    }
+
+    report->characteristic->setValue(report->data, report->length);
+
+    this->_reportHead = (this->_reportHead + 1) % BLE_HID_REPORT_QUEUE_SIZE;
+    this->_numReports--;
+  }
+}
+
+void BLEHIDPeripheral::polled() {
+  // central.connected() polls through BLEPeripheral, drain from there as well
+  this->sendReports();
+
+  for (int i = 0; i < this->_numHids; i++) {
+    this->_hids[i]->poll();
+  }
+}
+
+void BLEHIDPeripheral::clearReports() {
+  this->_reportHead = 0;
+  this->_numReports = 0;
+}
+
+void BLEHIDPeripheral::BLEDeviceConnected(BLEDevice& device, const unsigned char* address) {
+  this->_connected = true;
+
+  // every connection starts in report protocol, hosts that want boot write it again
+  this->_hidProtocolModeCharacteristic.setValue(BLE_HID_PROTOCOL_MODE_REPORT);
+
+  BLEPeripheral::BLEDeviceConnected(device, address);
+}
+
+void BLEHIDPeripheral::BLEDeviceDisconnected(BLEDevice& device) {
+  // reports of the old connection would replay stale key state on the next one
+  this->_connected = false;
+  this->clearReports();
+
+  BLEPeripheral::BLEDeviceDisconnected(device);
+}
@@ -8,6 +8,13 @@
 #include "BLEHIDReportMapCharacteristic.h"
 #include "BLEPeripheral.h"
 
+// reports waiting for a TX buffer, shared by all HIDs so they reach the central in order
+#ifndef BLE_HID_REPORT_QUEUE_SIZE
+#define BLE_HID_REPORT_QUEUE_SIZE 8
+#endif
+
+#define BLE_HID_REPORT_MAX_LENGTH 8
+
 class BLEHIDPeripheral : public BLEPeripheral
 {
   friend class BLEHID;
@@ -17,18 +24,41 @@ class BLEHIDPeripheral : public BLEPeripheral
     ~BLEHIDPeripheral();
 
     void begin();
+    void end();
 
     void clearBondStoreData();
     void setReportIdOffset(unsigned char reportIdOffset);
-
-    void poll();
+    // report map composed ahead of time in PROGMEM, report IDs included, HIDs must be added in the same order
+    void setReportMap(const unsigned char reportMap[], unsigned char length);
 
     void addHID(BLEHID& hid);
 
+    // true while the host selected the boot protocol through the Protocol Mode characteristic
+    bool bootProtocol();
+
+    unsigned char pendingReports();
+    unsigned char reportQueueAvailable();
+
   protected:
     static BLEHIDPeripheral* instance();
 
+    bool queueReport(BLECharacteristic& characteristic, const unsigned char data[], unsigned char length);
+    void sendReports();
+    virtual void polled();
+    void clearReports();
+
+    virtual void BLEDeviceConnected(BLEDevice& device, const unsigned char* address);
+    virtual void BLEDeviceDisconnected(BLEDevice& device);
+
   private:
+    void buildReportMap();
+
+    struct report {
+      BLECharacteristic*  characteristic;
+      unsigned char       length;
+      unsigned char       data[BLE_HID_REPORT_MAX_LENGTH];
+    };
+
     static BLEHIDPeripheral*            _instance;
 
     BLEBondStore                        _bleBondStore;
@@ -37,11 +67,20 @@ class BLEHIDPeripheral : public BLEPeripheral
     BLEHIDReportMapCharacteristic       _hidReportMapCharacteristic;
     BLEProgmemConstantCharacteristic    _hidInformationCharacteristic;
     BLEUnsignedCharCharacteristic       _hidControlPointCharacteristic;
+    BLEUnsignedCharCharacteristic       _hidProtocolModeCharacteristic;
 
     unsigned char                       _reportIdOffset;
+    const unsigned char*                _reportMap;
+    unsigned char                       _reportMapLength;
+    unsigned char*                      _builtReportMap;
 
     BLEHID**                            _hids;
     unsigned char                       _numHids;
+
+    bool                                _connected;
+    struct report                       _reports[BLE_HID_REPORT_QUEUE_SIZE];
+    unsigned char                       _reportHead;
+    unsigned char                       _numReports;
 };
 
 #endif
@@ -14,15 +14,12 @@ class BLEHIDReportMapCharacteristic : public BLEConstantCharacteristic
   public:
     BLEHIDReportMapCharacteristic();
 
-    virtual unsigned char valueSize() const;
-    virtual unsigned char valueLength() const;
     virtual unsigned char operator[] (int offset) const;
 
-    void setHids(BLEHID** hids, unsigned char numHids);
+    void setReportMap(const unsigned char reportMap[], unsigned char length, bool progmem);
 
   private:
-    BLEHID**                  _hids;
-    unsigned char             _numHids;
+    bool                      _progmem;
 };
 
 #endif
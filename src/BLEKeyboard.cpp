@@ -22,7 +22,6 @@ static const PROGMEM unsigned char descriptorValue[] = {
   0x95, 0x01,           //   REPORT_COUNT (1)
   0x75, 0x08,           //   REPORT_SIZE (8)
   0x81, 0x03,           //   INPUT (Cnst,Var,Abs) ; Reserved byte
-#ifdef USE_LED_REPORT
   0x95, 0x05,           //   REPORT_COUNT (5)
   0x75, 0x01,           //   REPORT_SIZE (1)
   0x05, 0x08,           //   USAGE_PAGE (LEDs)
@@ -32,8 +31,7 @@ static const PROGMEM unsigned char descriptorValue[] = {
   0x95, 0x01,           //   REPORT_COUNT (1)
   0x75, 0x03,           //   REPORT_SIZE (3)
   0x91, 0x03,           //   OUTPUT (Cnst,Var,Abs) ; LED report padding
-#endif
-  0x95, 0x05,           //   REPORT_COUNT (5)
+  0x95, 0x06,           //   REPORT_COUNT (6)
   0x75, 0x08,           //   REPORT_SIZE (8)
   0x15, 0x00,           //   LOGICAL_MINIMUM (0)
   0x26, 0xA4, 0x00,     //   LOGICAL_MAXIMUM (164)
@@ -47,7 +45,14 @@ static const PROGMEM unsigned char descriptorValue[] = {
 BLEKeyboard::BLEKeyboard() :
   BLEHID(descriptorValue, sizeof(descriptorValue), 7),
   _reportCharacteristic("2a4d", BLERead | BLENotify, 8),
-  _reportReferenceDescriptor(BLEHIDDescriptorTypeInput)
+  _reportReferenceDescriptor(BLEHIDDescriptorTypeInput),
+  _outputCharacteristic("2a4d", BLERead | BLEWrite | BLEWriteWithoutResponse, 1),
+  _outputReferenceDescriptor(BLEHIDDescriptorTypeOutput),
+  _bootInputCharacteristic("2a22", BLERead | BLENotify, 8),
+  _bootOutputCharacteristic("2a32", BLERead | BLEWrite | BLEWriteWithoutResponse, 1),
+  _leds(0),
+  _ledEventHandler(NULL),
+  _layout(BLE_KEYBOARD_DEFAULT_LAYOUT)
 {
   memset(this->_value, 0, sizeof(this->_value));
 }
@@ -55,14 +60,75 @@ BLEKeyboard::BLEKeyboard() :
 size_t BLEKeyboard::write(uint8_t k) {
   uint8_t code;
   uint8_t modifier;
+  bool dead;
+
+  this->keyToCodeAndModifier(k, code, modifier, dead);
+
+  if (code == 0) {
+    // nothing to type for it in this layout, consumed like typeText does
+    return 1;
+  }
+
+  // press and release go out together or not at all, a lone press would repeat on the host
+  if (!this->canSendData(dead ? 4 : 2)) {
+    return 0;
+  }
 
-  this->keyToCodeAndModifier(k, code, modifier);
+  if (dead) {
+    // the space completes the dead key with the plain character
+    return (this->press(code, modifier) && this->release(code, modifier) &&
+            this->press(KEYCODE_SPACE) && this->release(KEYCODE_SPACE));
+  }
 
   return (this->press(code, modifier) && this->release(code, modifier));
 }
 
+size_t BLEKeyboard::write(const uint8_t* buffer, size_t size) {
+  char text[17];
+  size_t written = 0;
+
+  // one pass over what the report queue takes now, the caller sends the rest later
+  while (written < size) {
+    size_t length = 0;
+
+    // typeText stops at a NUL, hand it NUL terminated chunks and step over embedded ones
+    while (length < sizeof(text) - 1 && written + length < size && buffer[written + length]) {
+      text[length] = buffer[written + length];
+      length++;
+    }
+    text[length] = 0;
+
+    if (length == 0) {
+      written++;
+      continue;
+    }
+
+    size_t typed = this->typeText(text);
+
+    written += typed;
+
+    if (typed < length) {
+      break;
+    }
+  }
+
+  return written;
+}
+
+int BLEKeyboard::availableForWrite() {
+  // press and release per character, dead keys need twice that
+  return this->reportQueueAvailable() / 2;
+}
+
+void BLEKeyboard::setLayout(const unsigned char* layout) {
+  this->_layout = layout;
+}
+
 size_t BLEKeyboard::press(uint8_t code, uint8_t modifiers) {
   size_t written = 0;
+  unsigned char value[sizeof(this->_value)];
+
+  memcpy(value, this->_value, sizeof(value));
 
   if (code != 0) {
     for (unsigned int i = 2; i < sizeof(this->_value); i++) {
@@ -79,8 +145,10 @@ size_t BLEKeyboard::press(uint8_t code, uint8_t modifiers) {
     written = 1;
   }
 
-  if (written) {
-    this->sendValue();
+  if (written && !this->sendValue()) {
+    // not queued, keep the state the central knows about
+    memcpy(this->_value, value, sizeof(value));
+    written = 0;
   }
 
   return written;
@@ -88,6 +156,9 @@ size_t BLEKeyboard::press(uint8_t code, uint8_t modifiers) {
 
 size_t BLEKeyboard::release(uint8_t code, uint8_t modifiers) {
   size_t cleared = 0;
+  unsigned char value[sizeof(this->_value)];
+
+  memcpy(value, this->_value, sizeof(value));
 
   if (code != 0) {
     for (unsigned int i = 2; i < sizeof(this->_value); i++) {
@@ -104,186 +175,218 @@ size_t BLEKeyboard::release(uint8_t code, uint8_t modifiers) {
     cleared = 1;
   }
 
-  if (cleared) {
-    this->sendValue();
+  if (cleared && !this->sendValue()) {
+    memcpy(this->_value, value, sizeof(value));
+    cleared = 0;
   }
 
   return cleared;
 }
 
+unsigned char BLEKeyboard::leds() {
+  return this->_leds;
+}
+
+void BLEKeyboard::setLedEventHandler(BLEKeyboardLedEventHandler eventHandler) {
+  this->_ledEventHandler = eventHandler;
+}
+
 void BLEKeyboard::releaseAll(void) {
   memset(this->_value, 0, sizeof(this->_value));
 
   this->sendValue();
 }
 
+static bool reportHasKey(const unsigned char report[], uint8_t code) {
+  for (unsigned int i = 2; i < 8; i++) {
+    if (report[i] == code) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool reportIsEmpty(const unsigned char report[]) {
+  for (unsigned int i = 0; i < 8; i++) {
+    if (report[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+size_t BLEKeyboard::typeText(const char* text) {
+  unsigned char report[sizeof(this->_value)];
+  unsigned char numKeys = 0;
+  size_t reportStart = 0;
+  size_t i;
+
+  memset(report, 0, sizeof(report));
+
+  // up to six distinct keys per report sharing one modifier, the host sees a
+  // press for every key that was up in the report before
+  for (i = 0; text[i]; i++) {
+    uint8_t code;
+    uint8_t modifier;
+    bool dead;
+
+    this->keyToCodeAndModifier(text[i], code, modifier, dead);
+
+    if (code == 0) {
+      continue;
+    }
+
+    if (dead) {
+      // a dead key only combines once released, it goes out on its own followed by a space
+      if (numKeys) {
+        if (!this->sendReport(report)) {
+          break;
+        }
+
+        memset(report, 0, sizeof(report));
+        numKeys = 0;
+      }
+
+      // release, dead key, release, space and the final release
+      if (!this->canSendData(5)) {
+        break;
+      }
+
+      if (!reportIsEmpty(this->_value)) {
+        this->sendReport(report);
+      }
+
+      report[0] = modifier;
+      report[2] = code;
+      this->sendReport(report);
+
+      memset(report, 0, sizeof(report));
+      this->sendReport(report);
+
+      report[2] = KEYCODE_SPACE;
+      this->sendReport(report);
+
+      memset(report, 0, sizeof(report));
+      continue;
+    }
+
+    if (numKeys && (numKeys == 6 || modifier != report[0] || reportHasKey(report, code))) {
+      if (!this->sendReport(report)) {
+        break;
+      }
+
+      memset(report, 0, sizeof(report));
+      numKeys = 0;
+    }
+
+    if (numKeys == 0) {
+      // a key still down or a different modifier needs everything released first
+      if (!reportIsEmpty(this->_value) && (modifier != this->_value[0] || reportHasKey(this->_value, code))) {
+        if (!this->sendReport(report)) {
+          break;
+        }
+      }
+
+      report[0] = modifier;
+      reportStart = i;
+    }
+
+    report[2 + numKeys] = code;
+    numKeys++;
+  }
+
+  if (numKeys && text[i] == 0 && this->sendReport(report)) {
+    numKeys = 0;
+  }
+
+  // sendReport keeps a slot free for this one
+  if (!reportIsEmpty(this->_value)) {
+    this->releaseAll();
+  }
+
+  return (numKeys) ? reportStart : i;
+}
+
 void BLEKeyboard::setReportId(unsigned char reportId) {
   BLEHID::setReportId(reportId);
 
   this->_reportReferenceDescriptor.setReportId(reportId);
+  this->_outputReferenceDescriptor.setReportId(reportId);
+}
+
+void BLEKeyboard::poll() {
+  // LED writes are picked up here rather than on the input report path
+  if (this->_outputCharacteristic.written()) {
+    this->setLeds(this->_outputCharacteristic.value()[0]);
+  }
+
+  if (this->_bootOutputCharacteristic.written()) {
+    this->setLeds(this->_bootOutputCharacteristic.value()[0]);
+  }
+}
+
+void BLEKeyboard::setLeds(unsigned char leds) {
+  if (leds == this->_leds) {
+    return;
+  }
+
+  this->_leds = leds;
+
+  if (this->_ledEventHandler) {
+    this->_ledEventHandler(leds);
+  }
 }
 
 unsigned char BLEKeyboard::numAttributes() {
-  return 2;
+  return 6;
 }
 
 BLELocalAttribute** BLEKeyboard::attributes() {
-  static BLELocalAttribute* attributes[2];
+  static BLELocalAttribute* attributes[6];
 
   attributes[0] = &this->_reportCharacteristic;
   attributes[1] = &this->_reportReferenceDescriptor;
+  attributes[2] = &this->_outputCharacteristic;
+  attributes[3] = &this->_outputReferenceDescriptor;
+  attributes[4] = &this->_bootInputCharacteristic;
+  attributes[5] = &this->_bootOutputCharacteristic;
 
   return attributes;
 }
 
-void BLEKeyboard::sendValue() {
-  BLEHID::sendData(this->_reportCharacteristic, this->_value, sizeof(this->_value));
+bool BLEKeyboard::sendValue() {
+  // the boot report has the same layout, only the characteristic differs
+  BLECharacteristic& characteristic = this->bootProtocol() ? this->_bootInputCharacteristic : this->_reportCharacteristic;
+
+  return BLEHID::sendData(characteristic, this->_value, sizeof(this->_value));
 }
 
+bool BLEKeyboard::sendReport(const unsigned char report[]) {
+  // always leave room for the final release
+  if (!this->canSendData(2)) {
+    return false;
+  }
+
+  memcpy(this->_value, report, sizeof(this->_value));
+
+  return this->sendValue();
+}
 
-#define SHIFT 0x80
-
-static const PROGMEM unsigned char asciiMap[] = {
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  KEYCODE_BACKSPACE,          // '\b'
-  KEYCODE_TAB,                // '\t'
-  KEYCODE_ENTER,              // '\n'
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  0x0,
-  KEYCODE_SPACE,              // ' '
-  0x1e | SHIFT,               // '!'
-  0x34 | SHIFT,               // '"'
-  0x20 | SHIFT,               // '#'
-  0x21 | SHIFT,               // '$'
-  0x22 | SHIFT,               // '%'
-  0x24 | SHIFT,               // '&'
-  0x34,                       // '''
-  0x26 | SHIFT,               // '('
-  0x27 | SHIFT,               // ')'
-  0x25 | SHIFT,               // '*'
-  0x2e | SHIFT,               // '+'
-  KEYCODE_COMMA,              // ','
-  KEYCODE_MINUS,              // '-'
-  KEYCODE_PERIOD,             // '.'
-  KEYCODE_SLASH,              // '/'
-  KEYCODE_0,                  // '0'
-  KEYCODE_1,                  // '1'
-  KEYCODE_2,                  // '2'
-  KEYCODE_3,                  // '3'
-  KEYCODE_4,                  // '4'
-  KEYCODE_5,                  // '5'
-  KEYCODE_6,                  // '6'
-  KEYCODE_7,                  // '7'
-  KEYCODE_8,                  // '8'
-  KEYCODE_9,                  // '9'
-  0x33 | SHIFT,               // ':'
-  0x33,                       // ';'
-  0x36 | SHIFT,               // '<'
-  KEYCODE_EQUAL,              // '='
-  0x37 | SHIFT,               // '>'
-  0x38 | SHIFT,               // '?'
-  0x1f | SHIFT,               // '@'
-  KEYCODE_A | SHIFT,          // 'A'
-  KEYCODE_B | SHIFT,          // 'B'
-  KEYCODE_C | SHIFT,          // 'C'
-  KEYCODE_D | SHIFT,          // 'D'
-  KEYCODE_E | SHIFT,          // 'E'
-  KEYCODE_F | SHIFT,          // 'F'
-  KEYCODE_G | SHIFT,          // 'G'
-  KEYCODE_H | SHIFT,          // 'H'
-  KEYCODE_I | SHIFT,          // 'I'
-  KEYCODE_J | SHIFT,          // 'J'
-  KEYCODE_K | SHIFT,          // 'K'
-  KEYCODE_L | SHIFT,          // 'L'
-  KEYCODE_M | SHIFT,          // 'M'
-  KEYCODE_N | SHIFT,          // 'N'
-  KEYCODE_O | SHIFT,          // 'O'
-  KEYCODE_P | SHIFT,          // 'P'
-  KEYCODE_Q | SHIFT,          // 'Q'
-  KEYCODE_R | SHIFT,          // 'R'
-  KEYCODE_S | SHIFT,          // 'S'
-  KEYCODE_T | SHIFT,          // 'T'
-  KEYCODE_U | SHIFT,          // 'U'
-  KEYCODE_V | SHIFT,          // 'V'
-  KEYCODE_W | SHIFT,          // 'W'
-  KEYCODE_X | SHIFT,          // 'X'
-  KEYCODE_Y | SHIFT,          // 'Y'
-  KEYCODE_Z | SHIFT,          // 'Z'
-  KEYCODE_SQBRAK_LEFT,        // '['
-  KEYCODE_BACKSLASH,          // '\'
-  KEYCODE_SQBRAK_RIGHT,       // ']'
-  0x23 | SHIFT,               // '^'
-  0x2d | SHIFT,               // '_'
-  0x35,                       // '`'
-  KEYCODE_A,                  // 'a'
-  KEYCODE_B,                  // 'b'
-  KEYCODE_C,                  // 'c'
-  KEYCODE_D,                  // 'd'
-  KEYCODE_E,                  // 'e'
-  KEYCODE_F,                  // 'f'
-  KEYCODE_G,                  // 'g'
-  KEYCODE_H,                  // 'h'
-  KEYCODE_I,                  // 'i'
-  KEYCODE_J,                  // 'j'
-  KEYCODE_K,                  // 'k'
-  KEYCODE_L,                  // 'l'
-  KEYCODE_M,                  // 'm'
-  KEYCODE_N,                  // 'n'
-  KEYCODE_O,                  // 'o'
-  KEYCODE_P,                  // 'p'
-  KEYCODE_Q,                  // 'q'
-  KEYCODE_R,                  // 'r'
-  KEYCODE_S,                  // 's'
-  KEYCODE_T,                  // 't'
-  KEYCODE_U,                  // 'u'
-  KEYCODE_V,                  // 'v'
-  KEYCODE_W,                  // 'w'
-  KEYCODE_X,                  // 'x'
-  KEYCODE_Y,                  // 'y'
-  KEYCODE_Z,                  // 'z'
-  0x2f | SHIFT,               // '{'
-  0x31 | SHIFT,               // '|'
-  0x30 | SHIFT,               // '}'
-  0x35 | SHIFT,               // '~'
-  0x0
-};
 
-void BLEKeyboard::keyToCodeAndModifier(uint8_t k, uint8_t& code, uint8_t& modifier) {
+void BLEKeyboard::keyToCodeAndModifier(uint8_t k, uint8_t& code, uint8_t& modifier, bool& dead) {
   code = 0;
   modifier = 0;
+  dead = false;
 
   if (k < 128) {
-    code = pgm_read_byte(asciiMap + k);
+    code = pgm_read_byte(this->_layout + k * 2);
+    modifier = pgm_read_byte(this->_layout + k * 2 + 1);
 
-    if (code & 0x80) {
-      modifier = KEYCODE_MOD_LEFT_SHIFT;
-      code &= 0x7f;
+    if (code & BLE_KEYBOARD_DEAD_KEY) {
+      dead = true;
+      code &= ~BLE_KEYBOARD_DEAD_KEY;
     }
   }
 }
@@ -111,30 +111,70 @@
 #define KEYCODE_ARROW_DOWN    0x51
 #define KEYCODE_ARROW_UP    0x52
 
+// layout tables in PROGMEM, indexed by ASCII character
+#define BLE_KEYBOARD_DEAD_KEY   0x80
+
+extern const unsigned char BLEKeyboardLayoutUS[];
+extern const unsigned char BLEKeyboardLayoutUK[];
+extern const unsigned char BLEKeyboardLayoutDE[];
+extern const unsigned char BLEKeyboardLayoutFR[];
+
+#ifndef BLE_KEYBOARD_DEFAULT_LAYOUT
+#define BLE_KEYBOARD_DEFAULT_LAYOUT BLEKeyboardLayoutUS
+#endif
+
+typedef void (*BLEKeyboardLedEventHandler)(unsigned char leds);
+
 class BLEKeyboard : public BLEHID, public Print
 {
   public:
     BLEKeyboard();
 
+    // 0 if the report queue has no room for the character, nothing is typed then
     virtual size_t write(uint8_t k);
+    // types what the report queue takes now, returns how much of buffer that was
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    using Print::write;
+    // characters write() takes right now, fewer for dead keys
+    virtual int availableForWrite();
     virtual size_t press(uint8_t keycode, uint8_t modifiers = 0);
     virtual size_t release(uint8_t keycode, uint8_t modifiers = 0);
     virtual void releaseAll();
 
+    // one of the BLEKeyboardLayout* tables, matching the layout the host is set to
+    void setLayout(const unsigned char* layout);
+
+    // types as much of text as the report queue takes, returns the number of characters consumed
+    size_t typeText(const char* text);
+
+    // KB_LED_* state last written by the host
+    unsigned char leds();
+    void setLedEventHandler(BLEKeyboardLedEventHandler eventHandler);
+
   protected:
     virtual void setReportId(unsigned char reportId);
+    virtual void poll();
     virtual unsigned char numAttributes();
     virtual BLELocalAttribute** attributes();
 
   private:
-    void sendValue();
-    void keyToCodeAndModifier(uint8_t k, uint8_t& code, uint8_t& modifier);
+    bool sendValue();
+    bool sendReport(const unsigned char report[]);
+    void setLeds(unsigned char leds);
+    void keyToCodeAndModifier(uint8_t k, uint8_t& code, uint8_t& modifier, bool& dead);
 
   private:
     BLECharacteristic                 _reportCharacteristic;
     BLEHIDReportReferenceDescriptor   _reportReferenceDescriptor;
+    BLECharacteristic                 _outputCharacteristic;
+    BLEHIDReportReferenceDescriptor   _outputReferenceDescriptor;
+    BLECharacteristic                 _bootInputCharacteristic;
+    BLECharacteristic                 _bootOutputCharacteristic;
 
     unsigned char                     _value[8];
+    unsigned char                     _leds;
+    BLEKeyboardLedEventHandler        _ledEventHandler;
+    const unsigned char*              _layout;
 };
 
 #endif
@@ -0,0 +1,536 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "BLEKeyboard.h"
+
+// two bytes per ASCII character: key code (with the dead key flag) and modifiers,
+// tables a sketch doesn't select are dropped by the linker
+#define NONE            0x00, 0x00
+#define KEY(code)       (code), 0x00
+#define SHIFT(code)     (code), KEYCODE_MOD_LEFT_SHIFT
+#define ALTGR(code)     (code), KEYCODE_MOD_RIGHT_ALT
+#define DEAD            BLE_KEYBOARD_DEAD_KEY
+
+const PROGMEM unsigned char BLEKeyboardLayoutUS[] = {
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  KEY(KEYCODE_BACKSPACE),           // '\b'
+  KEY(KEYCODE_TAB),                 // '\t'
+  KEY(KEYCODE_ENTER),               // '\n'
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  KEY(KEYCODE_SPACE),               // ' '
+  SHIFT(KEYCODE_1),                 // '!'
+  SHIFT(0x34),                      // '"'
+  SHIFT(KEYCODE_3),                 // '#'
+  SHIFT(KEYCODE_4),                 // '$'
+  SHIFT(KEYCODE_5),                 // '%'
+  SHIFT(KEYCODE_7),                 // '&'
+  KEY(0x34),                        // '''
+  SHIFT(KEYCODE_9),                 // '('
+  SHIFT(KEYCODE_0),                 // ')'
+  SHIFT(KEYCODE_8),                 // '*'
+  SHIFT(KEYCODE_EQUAL),             // '+'
+  KEY(KEYCODE_COMMA),               // ','
+  KEY(KEYCODE_MINUS),               // '-'
+  KEY(KEYCODE_PERIOD),              // '.'
+  KEY(KEYCODE_SLASH),               // '/'
+  KEY(KEYCODE_0),                   // '0'
+  KEY(KEYCODE_1),                   // '1'
+  KEY(KEYCODE_2),                   // '2'
+  KEY(KEYCODE_3),                   // '3'
+  KEY(KEYCODE_4),                   // '4'
+  KEY(KEYCODE_5),                   // '5'
+  KEY(KEYCODE_6),                   // '6'
+  KEY(KEYCODE_7),                   // '7'
+  KEY(KEYCODE_8),                   // '8'
+  KEY(KEYCODE_9),                   // '9'
+  SHIFT(0x33),                      // ':'
+  KEY(0x33),                        // ';'
+  SHIFT(KEYCODE_COMMA),             // '<'
+  KEY(KEYCODE_EQUAL),               // '='
+  SHIFT(KEYCODE_PERIOD),            // '>'
+  SHIFT(KEYCODE_SLASH),             // '?'
+  SHIFT(KEYCODE_2),                 // '@'
+  SHIFT(KEYCODE_A),                 // 'A'
+  SHIFT(KEYCODE_B),                 // 'B'
+  SHIFT(KEYCODE_C),                 // 'C'
+  SHIFT(KEYCODE_D),                 // 'D'
+  SHIFT(KEYCODE_E),                 // 'E'
+  SHIFT(KEYCODE_F),                 // 'F'
+  SHIFT(KEYCODE_G),                 // 'G'
+  SHIFT(KEYCODE_H),                 // 'H'
+  SHIFT(KEYCODE_I),                 // 'I'
+  SHIFT(KEYCODE_J),                 // 'J'
+  SHIFT(KEYCODE_K),                 // 'K'
+  SHIFT(KEYCODE_L),                 // 'L'
+  SHIFT(KEYCODE_M),                 // 'M'
+  SHIFT(KEYCODE_N),                 // 'N'
+  SHIFT(KEYCODE_O),                 // 'O'
+  SHIFT(KEYCODE_P),                 // 'P'
+  SHIFT(KEYCODE_Q),                 // 'Q'
+  SHIFT(KEYCODE_R),                 // 'R'
+  SHIFT(KEYCODE_S),                 // 'S'
+  SHIFT(KEYCODE_T),                 // 'T'
+  SHIFT(KEYCODE_U),                 // 'U'
+  SHIFT(KEYCODE_V),                 // 'V'
+  SHIFT(KEYCODE_W),                 // 'W'
+  SHIFT(KEYCODE_X),                 // 'X'
+  SHIFT(KEYCODE_Y),                 // 'Y'
+  SHIFT(KEYCODE_Z),                 // 'Z'
+  KEY(KEYCODE_SQBRAK_LEFT),         // '['
+  KEY(KEYCODE_BACKSLASH),           // '\'
+  KEY(KEYCODE_SQBRAK_RIGHT),        // ']'
+  SHIFT(KEYCODE_6),                 // '^'
+  SHIFT(KEYCODE_MINUS),             // '_'
+  KEY(0x35),                        // '`'
+  KEY(KEYCODE_A),                   // 'a'
+  KEY(KEYCODE_B),                   // 'b'
+  KEY(KEYCODE_C),                   // 'c'
+  KEY(KEYCODE_D),                   // 'd'
+  KEY(KEYCODE_E),                   // 'e'
+  KEY(KEYCODE_F),                   // 'f'
+  KEY(KEYCODE_G),                   // 'g'
+  KEY(KEYCODE_H),                   // 'h'
+  KEY(KEYCODE_I),                   // 'i'
+  KEY(KEYCODE_J),                   // 'j'
+  KEY(KEYCODE_K),                   // 'k'
+  KEY(KEYCODE_L),                   // 'l'
+  KEY(KEYCODE_M),                   // 'm'
+  KEY(KEYCODE_N),                   // 'n'
+  KEY(KEYCODE_O),                   // 'o'
+  KEY(KEYCODE_P),                   // 'p'
+  KEY(KEYCODE_Q),                   // 'q'
+  KEY(KEYCODE_R),                   // 'r'
+  KEY(KEYCODE_S),                   // 's'
+  KEY(KEYCODE_T),                   // 't'
+  KEY(KEYCODE_U),                   // 'u'
+  KEY(KEYCODE_V),                   // 'v'
+  KEY(KEYCODE_W),                   // 'w'
+  KEY(KEYCODE_X),                   // 'x'
+  KEY(KEYCODE_Y),                   // 'y'
+  KEY(KEYCODE_Z),                   // 'z'
+  SHIFT(KEYCODE_SQBRAK_LEFT),       // '{'
+  SHIFT(KEYCODE_BACKSLASH),         // '|'
+  SHIFT(KEYCODE_SQBRAK_RIGHT),      // '}'
+  SHIFT(0x35),                      // '~'
+  NONE,
+};
+
+const PROGMEM unsigned char BLEKeyboardLayoutUK[] = {
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  KEY(KEYCODE_BACKSPACE),           // '\b'
+  KEY(KEYCODE_TAB),                 // '\t'
+  KEY(KEYCODE_ENTER),               // '\n'
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  KEY(KEYCODE_SPACE),               // ' '
+  SHIFT(KEYCODE_1),                 // '!'
+  SHIFT(KEYCODE_2),                 // '"'
+  KEY(0x32),                        // '#'
+  SHIFT(KEYCODE_4),                 // '$'
+  SHIFT(KEYCODE_5),                 // '%'
+  SHIFT(KEYCODE_7),                 // '&'
+  KEY(0x34),                        // '''
+  SHIFT(KEYCODE_9),                 // '('
+  SHIFT(KEYCODE_0),                 // ')'
+  SHIFT(KEYCODE_8),                 // '*'
+  SHIFT(KEYCODE_EQUAL),             // '+'
+  KEY(KEYCODE_COMMA),               // ','
+  KEY(KEYCODE_MINUS),               // '-'
+  KEY(KEYCODE_PERIOD),              // '.'
+  KEY(KEYCODE_SLASH),               // '/'
+  KEY(KEYCODE_0),                   // '0'
+  KEY(KEYCODE_1),                   // '1'
+  KEY(KEYCODE_2),                   // '2'
+  KEY(KEYCODE_3),                   // '3'
+  KEY(KEYCODE_4),                   // '4'
+  KEY(KEYCODE_5),                   // '5'
+  KEY(KEYCODE_6),                   // '6'
+  KEY(KEYCODE_7),                   // '7'
+  KEY(KEYCODE_8),                   // '8'
+  KEY(KEYCODE_9),                   // '9'
+  SHIFT(0x33),                      // ':'
+  KEY(0x33),                        // ';'
+  SHIFT(KEYCODE_COMMA),             // '<'
+  KEY(KEYCODE_EQUAL),               // '='
+  SHIFT(KEYCODE_PERIOD),            // '>'
+  SHIFT(KEYCODE_SLASH),             // '?'
+  SHIFT(0x34),                      // '@'
+  SHIFT(KEYCODE_A),                 // 'A'
+  SHIFT(KEYCODE_B),                 // 'B'
+  SHIFT(KEYCODE_C),                 // 'C'
+  SHIFT(KEYCODE_D),                 // 'D'
+  SHIFT(KEYCODE_E),                 // 'E'
+  SHIFT(KEYCODE_F),                 // 'F'
+  SHIFT(KEYCODE_G),                 // 'G'
+  SHIFT(KEYCODE_H),                 // 'H'
+  SHIFT(KEYCODE_I),                 // 'I'
+  SHIFT(KEYCODE_J),                 // 'J'
+  SHIFT(KEYCODE_K),                 // 'K'
+  SHIFT(KEYCODE_L),                 // 'L'
+  SHIFT(KEYCODE_M),                 // 'M'
+  SHIFT(KEYCODE_N),                 // 'N'
+  SHIFT(KEYCODE_O),                 // 'O'
+  SHIFT(KEYCODE_P),                 // 'P'
+  SHIFT(KEYCODE_Q),                 // 'Q'
+  SHIFT(KEYCODE_R),                 // 'R'
+  SHIFT(KEYCODE_S),                 // 'S'
+  SHIFT(KEYCODE_T),                 // 'T'
+  SHIFT(KEYCODE_U),                 // 'U'
+  SHIFT(KEYCODE_V),                 // 'V'
+  SHIFT(KEYCODE_W),                 // 'W'
+  SHIFT(KEYCODE_X),                 // 'X'
+  SHIFT(KEYCODE_Y),                 // 'Y'
+  SHIFT(KEYCODE_Z),                 // 'Z'
+  KEY(KEYCODE_SQBRAK_LEFT),         // '['
+  KEY(0x64),                        // '\'
+  KEY(KEYCODE_SQBRAK_RIGHT),        // ']'
+  SHIFT(KEYCODE_6),                 // '^'
+  SHIFT(KEYCODE_MINUS),             // '_'
+  KEY(0x35),                        // '`'
+  KEY(KEYCODE_A),                   // 'a'
+  KEY(KEYCODE_B),                   // 'b'
+  KEY(KEYCODE_C),                   // 'c'
+  KEY(KEYCODE_D),                   // 'd'
+  KEY(KEYCODE_E),                   // 'e'
+  KEY(KEYCODE_F),                   // 'f'
+  KEY(KEYCODE_G),                   // 'g'
+  KEY(KEYCODE_H),                   // 'h'
+  KEY(KEYCODE_I),                   // 'i'
+  KEY(KEYCODE_J),                   // 'j'
+  KEY(KEYCODE_K),                   // 'k'
+  KEY(KEYCODE_L),                   // 'l'
+  KEY(KEYCODE_M),                   // 'm'
+  KEY(KEYCODE_N),                   // 'n'
+  KEY(KEYCODE_O),                   // 'o'
+  KEY(KEYCODE_P),                   // 'p'
+  KEY(KEYCODE_Q),                   // 'q'
+  KEY(KEYCODE_R),                   // 'r'
+  KEY(KEYCODE_S),                   // 's'
+  KEY(KEYCODE_T),                   // 't'
+  KEY(KEYCODE_U),                   // 'u'
+  KEY(KEYCODE_V),                   // 'v'
+  KEY(KEYCODE_W),                   // 'w'
+  KEY(KEYCODE_X),                   // 'x'
+  KEY(KEYCODE_Y),                   // 'y'
+  KEY(KEYCODE_Z),                   // 'z'
+  SHIFT(KEYCODE_SQBRAK_LEFT),       // '{'
+  SHIFT(0x64),                      // '|'
+  SHIFT(KEYCODE_SQBRAK_RIGHT),      // '}'
+  SHIFT(0x32),                      // '~'
+  NONE,
+};
+
+const PROGMEM unsigned char BLEKeyboardLayoutDE[] = {
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  KEY(KEYCODE_BACKSPACE),           // '\b'
+  KEY(KEYCODE_TAB),                 // '\t'
+  KEY(KEYCODE_ENTER),               // '\n'
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  KEY(KEYCODE_SPACE),               // ' '
+  SHIFT(KEYCODE_1),                 // '!'
+  SHIFT(KEYCODE_2),                 // '"'
+  KEY(0x32),                        // '#'
+  SHIFT(KEYCODE_4),                 // '$'
+  SHIFT(KEYCODE_5),                 // '%'
+  SHIFT(KEYCODE_6),                 // '&'
+  SHIFT(0x32),                      // '''
+  SHIFT(KEYCODE_8),                 // '('
+  SHIFT(KEYCODE_9),                 // ')'
+  SHIFT(KEYCODE_SQBRAK_RIGHT),      // '*'
+  KEY(KEYCODE_SQBRAK_RIGHT),        // '+'
+  KEY(KEYCODE_COMMA),               // ','
+  KEY(KEYCODE_SLASH),               // '-'
+  KEY(KEYCODE_PERIOD),              // '.'
+  SHIFT(KEYCODE_7),                 // '/'
+  KEY(KEYCODE_0),                   // '0'
+  KEY(KEYCODE_1),                   // '1'
+  KEY(KEYCODE_2),                   // '2'
+  KEY(KEYCODE_3),                   // '3'
+  KEY(KEYCODE_4),                   // '4'
+  KEY(KEYCODE_5),                   // '5'
+  KEY(KEYCODE_6),                   // '6'
+  KEY(KEYCODE_7),                   // '7'
+  KEY(KEYCODE_8),                   // '8'
+  KEY(KEYCODE_9),                   // '9'
+  SHIFT(KEYCODE_PERIOD),            // ':'
+  SHIFT(KEYCODE_COMMA),             // ';'
+  KEY(0x64),                        // '<'
+  SHIFT(KEYCODE_0),                 // '='
+  SHIFT(0x64),                      // '>'
+  SHIFT(KEYCODE_MINUS),             // '?'
+  ALTGR(KEYCODE_Q),                 // '@'
+  SHIFT(KEYCODE_A),                 // 'A'
+  SHIFT(KEYCODE_B),                 // 'B'
+  SHIFT(KEYCODE_C),                 // 'C'
+  SHIFT(KEYCODE_D),                 // 'D'
+  SHIFT(KEYCODE_E),                 // 'E'
+  SHIFT(KEYCODE_F),                 // 'F'
+  SHIFT(KEYCODE_G),                 // 'G'
+  SHIFT(KEYCODE_H),                 // 'H'
+  SHIFT(KEYCODE_I),                 // 'I'
+  SHIFT(KEYCODE_J),                 // 'J'
+  SHIFT(KEYCODE_K),                 // 'K'
+  SHIFT(KEYCODE_L),                 // 'L'
+  SHIFT(KEYCODE_M),                 // 'M'
+  SHIFT(KEYCODE_N),                 // 'N'
+  SHIFT(KEYCODE_O),                 // 'O'
+  SHIFT(KEYCODE_P),                 // 'P'
+  SHIFT(KEYCODE_Q),                 // 'Q'
+  SHIFT(KEYCODE_R),                 // 'R'
+  SHIFT(KEYCODE_S),                 // 'S'
+  SHIFT(KEYCODE_T),                 // 'T'
+  SHIFT(KEYCODE_U),                 // 'U'
+  SHIFT(KEYCODE_V),                 // 'V'
+  SHIFT(KEYCODE_W),                 // 'W'
+  SHIFT(KEYCODE_X),                 // 'X'
+  SHIFT(KEYCODE_Z),                 // 'Y'
+  SHIFT(KEYCODE_Y),                 // 'Z'
+  ALTGR(KEYCODE_8),                 // '['
+  ALTGR(KEYCODE_MINUS),             // '\'
+  ALTGR(KEYCODE_9),                 // ']'
+  KEY(0x35 | DEAD),                 // '^'
+  SHIFT(KEYCODE_SLASH),             // '_'
+  SHIFT(KEYCODE_EQUAL | DEAD),      // '`'
+  KEY(KEYCODE_A),                   // 'a'
+  KEY(KEYCODE_B),                   // 'b'
+  KEY(KEYCODE_C),                   // 'c'
+  KEY(KEYCODE_D),                   // 'd'
+  KEY(KEYCODE_E),                   // 'e'
+  KEY(KEYCODE_F),                   // 'f'
+  KEY(KEYCODE_G),                   // 'g'
+  KEY(KEYCODE_H),                   // 'h'
+  KEY(KEYCODE_I),                   // 'i'
+  KEY(KEYCODE_J),                   // 'j'
+  KEY(KEYCODE_K),                   // 'k'
+  KEY(KEYCODE_L),                   // 'l'
+  KEY(KEYCODE_M),                   // 'm'
+  KEY(KEYCODE_N),                   // 'n'
+  KEY(KEYCODE_O),                   // 'o'
+  KEY(KEYCODE_P),                   // 'p'
+  KEY(KEYCODE_Q),                   // 'q'
+  KEY(KEYCODE_R),                   // 'r'
+  KEY(KEYCODE_S),                   // 's'
+  KEY(KEYCODE_T),                   // 't'
+  KEY(KEYCODE_U),                   // 'u'
+  KEY(KEYCODE_V),                   // 'v'
+  KEY(KEYCODE_W),                   // 'w'
+  KEY(KEYCODE_X),                   // 'x'
+  KEY(KEYCODE_Z),                   // 'y'
+  KEY(KEYCODE_Y),                   // 'z'
+  ALTGR(KEYCODE_7),                 // '{'
+  ALTGR(0x64),                      // '|'
+  ALTGR(KEYCODE_0),                 // '}'
+  ALTGR(KEYCODE_SQBRAK_RIGHT),      // '~'
+  NONE,
+};
+
+const PROGMEM unsigned char BLEKeyboardLayoutFR[] = {
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  KEY(KEYCODE_BACKSPACE),           // '\b'
+  KEY(KEYCODE_TAB),                 // '\t'
+  KEY(KEYCODE_ENTER),               // '\n'
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  NONE,
+  KEY(KEYCODE_SPACE),               // ' '
+  KEY(KEYCODE_SLASH),               // '!'
+  KEY(KEYCODE_3),                   // '"'
+  ALTGR(KEYCODE_3),                 // '#'
+  KEY(KEYCODE_SQBRAK_RIGHT),        // '$'
+  SHIFT(0x34),                      // '%'
+  KEY(KEYCODE_1),                   // '&'
+  KEY(KEYCODE_4),                   // '''
+  KEY(KEYCODE_5),                   // '('
+  KEY(KEYCODE_MINUS),               // ')'
+  KEY(0x32),                        // '*'
+  SHIFT(KEYCODE_EQUAL),             // '+'
+  KEY(KEYCODE_M),                   // ','
+  KEY(KEYCODE_6),                   // '-'
+  SHIFT(KEYCODE_COMMA),             // '.'
+  SHIFT(KEYCODE_PERIOD),            // '/'
+  SHIFT(KEYCODE_0),                 // '0'
+  SHIFT(KEYCODE_1),                 // '1'
+  SHIFT(KEYCODE_2),                 // '2'
+  SHIFT(KEYCODE_3),                 // '3'
+  SHIFT(KEYCODE_4),                 // '4'
+  SHIFT(KEYCODE_5),                 // '5'
+  SHIFT(KEYCODE_6),                 // '6'
+  SHIFT(KEYCODE_7),                 // '7'
+  SHIFT(KEYCODE_8),                 // '8'
+  SHIFT(KEYCODE_9),                 // '9'
+  KEY(KEYCODE_PERIOD),              // ':'
+  KEY(KEYCODE_COMMA),               // ';'
+  KEY(0x64),                        // '<'
+  KEY(KEYCODE_EQUAL),               // '='
+  SHIFT(0x64),                      // '>'
+  SHIFT(KEYCODE_M),                 // '?'
+  ALTGR(KEYCODE_0),                 // '@'
+  SHIFT(KEYCODE_Q),                 // 'A'
+  SHIFT(KEYCODE_B),                 // 'B'
+  SHIFT(KEYCODE_C),                 // 'C'
+  SHIFT(KEYCODE_D),                 // 'D'
+  SHIFT(KEYCODE_E),                 // 'E'
+  SHIFT(KEYCODE_F),                 // 'F'
+  SHIFT(KEYCODE_G),                 // 'G'
+  SHIFT(KEYCODE_H),                 // 'H'
+  SHIFT(KEYCODE_I),                 // 'I'
+  SHIFT(KEYCODE_J),                 // 'J'
+  SHIFT(KEYCODE_K),                 // 'K'
+  SHIFT(KEYCODE_L),                 // 'L'
+  SHIFT(0x33),                      // 'M'
+  SHIFT(KEYCODE_N),                 // 'N'
+  SHIFT(KEYCODE_O),                 // 'O'
+  SHIFT(KEYCODE_P),                 // 'P'
+  SHIFT(KEYCODE_A),                 // 'Q'
+  SHIFT(KEYCODE_R),                 // 'R'
+  SHIFT(KEYCODE_S),                 // 'S'
+  SHIFT(KEYCODE_T),                 // 'T'
+  SHIFT(KEYCODE_U),                 // 'U'
+  SHIFT(KEYCODE_V),                 // 'V'
+  SHIFT(KEYCODE_Z),                 // 'W'
+  SHIFT(KEYCODE_X),                 // 'X'
+  SHIFT(KEYCODE_Y),                 // 'Y'
+  SHIFT(KEYCODE_W),                 // 'Z'
+  ALTGR(KEYCODE_5),                 // '['
+  ALTGR(KEYCODE_8),                 // '\'
+  ALTGR(KEYCODE_MINUS),             // ']'
+  ALTGR(KEYCODE_9),                 // '^'
+  KEY(KEYCODE_8),                   // '_'
+  ALTGR(KEYCODE_7 | DEAD),          // '`'
+  KEY(KEYCODE_Q),                   // 'a'
+  KEY(KEYCODE_B),                   // 'b'
+  KEY(KEYCODE_C),                   // 'c'
+  KEY(KEYCODE_D),                   // 'd'
+  KEY(KEYCODE_E),                   // 'e'
+  KEY(KEYCODE_F),                   // 'f'
+  KEY(KEYCODE_G),                   // 'g'
+  KEY(KEYCODE_H),                   // 'h'
+  KEY(KEYCODE_I),                   // 'i'
+  KEY(KEYCODE_J),                   // 'j'
+  KEY(KEYCODE_K),                   // 'k'
+  KEY(KEYCODE_L),                   // 'l'
+  KEY(0x33),                        // 'm'
+  KEY(KEYCODE_N),                   // 'n'
+  KEY(KEYCODE_O),                   // 'o'
+  KEY(KEYCODE_P),                   // 'p'
+  KEY(KEYCODE_A),                   // 'q'
+  KEY(KEYCODE_R),                   // 'r'
+  KEY(KEYCODE_S),                   // 's'
+  KEY(KEYCODE_T),                   // 't'
+  KEY(KEYCODE_U),                   // 'u'
+  KEY(KEYCODE_V),                   // 'v'
+  KEY(KEYCODE_Z),                   // 'w'
+  KEY(KEYCODE_X),                   // 'x'
+  KEY(KEYCODE_Y),                   // 'y'
+  KEY(KEYCODE_W),                   // 'z'
+  ALTGR(KEYCODE_4),                 // '{'
+  ALTGR(KEYCODE_6),                 // '|'
+  ALTGR(KEYCODE_EQUAL),             // '}'
+  ALTGR(KEYCODE_2 | DEAD),          // '~'
+  NONE,
+};
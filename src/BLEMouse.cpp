@@ -1,6 +1,8 @@
 // Copyright (c) Sandeep Mistry. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#include "BLEHIDPeripheral.h"
+
 #include "BLEMouse.h"
 
 static const PROGMEM unsigned char descriptorValue[] = {
@@ -40,16 +42,60 @@ BLEMouse::BLEMouse() :
   BLEHID(descriptorValue, sizeof(descriptorValue), 11),
   _reportCharacteristic("2a4d", BLERead | BLENotify, 4),
   _reportReferenceDescriptor(BLEHIDDescriptorTypeInput),
-  _button(0)
+  _bootInputCharacteristic("2a33", BLERead | BLENotify, 3),
+  _button(0),
+  _accumulate(false),
+  _x(0),
+  _y(0),
+  _wheel(0)
 {
 }
 
+static int addSaturated(int value, signed char delta) {
+  long sum = (long)value + delta;
+
+  if (sum > 32767) {
+    sum = 32767;
+  } else if (sum < -32767) {
+    sum = -32767;
+  }
+
+  return sum;
+}
+
+static signed char takeDelta(int& value) {
+  // the report carries -127 to 127, the rest stays for the next one
+  int delta = value;
+
+  if (delta > 127) {
+    delta = 127;
+  } else if (delta < -127) {
+    delta = -127;
+  }
+
+  value -= delta;
+
+  return delta;
+}
+
 void BLEMouse::click(uint8_t b) {
+  if (!this->canSendData(2)) {
+    return;
+  }
+
   this->press(b);
   this->release(b);
 }
 
-void BLEMouse::move(signed char x, signed char y, signed char wheel) {
+bool BLEMouse::move(signed char x, signed char y, signed char wheel) {
+  if (this->_accumulate) {
+    this->_x = addSaturated(this->_x, x);
+    this->_y = addSaturated(this->_y, y);
+    this->_wheel = addSaturated(this->_wheel, wheel);
+
+    return true;
+  }
+
   unsigned char mouseMove[4]= { 0x00, 0x00, 0x00, 0x00 };
 
   // send key code
@@ -58,25 +104,99 @@ void BLEMouse::move(signed char x, signed char y, signed char wheel) {
   mouseMove[2] = y;
   mouseMove[3] = wheel;
 
-  this->sendData(this->_reportCharacteristic, mouseMove, sizeof(mouseMove));
+  return this->sendMove(mouseMove);
 }
 
-void BLEMouse::press(uint8_t b) {
+bool BLEMouse::press(uint8_t b) {
+  unsigned char button = this->_button;
+
   this->_button |= b;
 
-  this->move(0, 0, 0);
+  if (!this->sendReport()) {
+    this->_button = button;
+    return false;
+  }
+
+  return true;
 }
 
-void BLEMouse::release(uint8_t b) {
+bool BLEMouse::release(uint8_t b) {
+  unsigned char button = this->_button;
+
   this->_button &= ~b;
 
-  this->move(0, 0, 0);
+  if (!this->sendReport()) {
+    this->_button = button;
+    return false;
+  }
+
+  return true;
 }
 
 bool BLEMouse::isPressed(uint8_t b) {
  return ((this->_button & b) != 0);
 }
 
+void BLEMouse::setAccumulate(bool accumulate) {
+  this->_accumulate = accumulate;
+
+  if (!accumulate) {
+    // motion summed so far would otherwise ride along with the next button change
+    this->clearMotion();
+  }
+}
+
+void BLEMouse::clearMotion() {
+  this->_x = 0;
+  this->_y = 0;
+  this->_wheel = 0;
+}
+
+bool BLEMouse::sendReport() {
+  int x = this->_x;
+  int y = this->_y;
+  int wheel = this->_wheel;
+  unsigned char mouseMove[4];
+
+  // button changes carry the motion summed so far
+  mouseMove[0] = this->_button;
+  mouseMove[1] = takeDelta(this->_x);
+  mouseMove[2] = takeDelta(this->_y);
+  mouseMove[3] = takeDelta(this->_wheel);
+
+  if (!this->sendMove(mouseMove)) {
+    this->_x = x;
+    this->_y = y;
+    this->_wheel = wheel;
+
+    return false;
+  }
+
+  return true;
+}
+
+bool BLEMouse::sendMove(unsigned char mouseMove[]) {
+  if (this->bootProtocol()) {
+    // boot reports are buttons, x and y, no wheel
+    return this->sendData(this->_bootInputCharacteristic, mouseMove, 3);
+  }
+
+  return this->sendData(this->_reportCharacteristic, mouseMove, 4);
+}
+
+void BLEMouse::poll() {
+  if (!this->connected()) {
+    // stale motion must not jump the pointer on the next connection
+    this->clearMotion();
+    return;
+  }
+
+  // only once the report queue is empty, motion keeps summing up meanwhile
+  if ((this->_x || this->_y || this->_wheel) && this->canSendData(BLE_HID_REPORT_QUEUE_SIZE)) {
+    this->sendReport();
+  }
+}
+
 void BLEMouse::setReportId(unsigned char reportId) {
   BLEHID::setReportId(reportId);
 
@@ -84,14 +204,15 @@ void BLEMouse::setReportId(unsigned char reportId) {
 }
 
 unsigned char BLEMouse::numAttributes() {
-  return 2;
+  return 3;
 }
 
 BLELocalAttribute** BLEMouse::attributes() {
-  static BLELocalAttribute* attributes[2];
+  static BLELocalAttribute* attributes[3];
 
   attributes[0] = &this->_reportCharacteristic;
   attributes[1] = &this->_reportReferenceDescriptor;
+  attributes[2] = &this->_bootInputCharacteristic;
 
   return attributes;
 }
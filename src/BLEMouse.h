@@ -24,21 +24,35 @@ class BLEMouse : public BLEHID
     BLEMouse();
 
     void click(uint8_t b = MOUSEBTN_LEFT_MASK);
-    void move(signed char x, signed char y, signed char wheel = 0);
-    void press(uint8_t b = MOUSEBTN_LEFT_MASK);
-    void release(uint8_t b = MOUSEBTN_LEFT_MASK);
+    bool move(signed char x, signed char y, signed char wheel = 0);
+    bool press(uint8_t b = MOUSEBTN_LEFT_MASK);
+    bool release(uint8_t b = MOUSEBTN_LEFT_MASK);
     bool isPressed(uint8_t b = MOUSEBTN_LEFT_MASK);
 
+    // sum move() deltas and send them once a TX buffer is free instead of a report per call
+    void setAccumulate(bool accumulate);
+
   protected:
     virtual void setReportId(unsigned char reportId);
+    virtual void poll();
     virtual unsigned char numAttributes();
     virtual BLELocalAttribute** attributes();
 
   private:
     BLECharacteristic                 _reportCharacteristic;
     BLEHIDReportReferenceDescriptor   _reportReferenceDescriptor;
+    BLECharacteristic                 _bootInputCharacteristic;
+
+    bool sendReport();
+    bool sendMove(unsigned char mouseMove[]);
+    void clearMotion();
 
     unsigned char                     _button;
+
+    bool                              _accumulate;
+    int                               _x;
+    int                               _y;
+    int                               _wheel;
 };
 
 #endif
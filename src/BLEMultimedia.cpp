@@ -23,26 +23,18 @@ static const PROGMEM unsigned char descriptorValue[] = {
 };
 
 BLEMultimedia::BLEMultimedia() :
-  BLEHID(descriptorValue, sizeof(descriptorValue), 7),
+  BLESequenceHID(descriptorValue, sizeof(descriptorValue), 7),
   _reportCharacteristic("2a4d", BLERead | BLENotify, 2),
   _reportReferenceDescriptor(BLEHIDDescriptorTypeInput)
 {
 }
 
-size_t BLEMultimedia::write(uint8_t k) {
+bool BLEMultimedia::sendKey(uint8_t k) {
   uint8_t multimediaKeyPress[2]= { 0x00, 0x00 };
 
-  // send key code
   multimediaKeyPress[0] = k;
 
-  for (int i = 0; i < 2; i++) {
-    this->sendData(this->_reportCharacteristic, multimediaKeyPress, sizeof(multimediaKeyPress));
-
-    // send cleared code
-    multimediaKeyPress[0] = 0x00;
-  }
-
-  return 1;
+  return this->sendData(this->_reportCharacteristic, multimediaKeyPress, sizeof(multimediaKeyPress));
 }
 
 void BLEMultimedia::setReportId(unsigned char reportId) {
@@ -8,7 +8,7 @@
 
 #include "BLECharacteristic.h"
 #include "BLEHIDReportReferenceDescriptor.h"
-#include "BLEHID.h"
+#include "BLESequenceHID.h"
 
 // From: https://github.com/adafruit/Adafruit-Trinket-USB/blob/master/TrinketHidCombo/TrinketHidCombo.h
 //       permission to use under MIT license by @ladyada (https://github.com/adafruit/Adafruit-Trinket-USB/issues/10)
@@ -38,14 +38,14 @@
 #define MMKEY_KB_FIND     0x7E
 #define MMKEY_KB_MUTE     0x7F // do not use
 
-class BLEMultimedia : public BLEHID
+class BLEMultimedia : public BLESequenceHID
 {
   public:
     BLEMultimedia();
 
-    size_t write(uint8_t k);
-
   protected:
+    virtual bool sendKey(uint8_t k);
+
     virtual void setReportId(unsigned char reportId);
     virtual unsigned char numAttributes();
     virtual BLELocalAttribute** attributes();
@@ -26,21 +26,24 @@ BLEPeripheral::BLEPeripheral(unsigned char req, unsigned char rdy, unsigned char
   _manufacturerDataLength(0),
   _localName(NULL),
 
+  _gattDatabase(NULL),
+  _arena(NULL),
   _localAttributes(NULL),
   _numLocalAttributes(0),
   _remoteAttributes(NULL),
   _numRemoteAttributes(0),
 
   _genericAccessService("1800"),
-  _deviceNameCharacteristic("2a00", BLERead, 19),
-  _appearanceCharacteristic("2a01", BLERead, 2),
+  _deviceNameCharacteristic("2a00", BLERead),
+  _appearanceCharacteristic("2a01", BLERead),
   _genericAttributeService("1801"),
-  _servicesChangedCharacteristic("2a05", BLEIndicate, 4),
+  _servicesChangedCharacteristic("2a05", BLEIndicate),
 
   _remoteGenericAttributeService("1801"),
   _remoteServicesChangedCharacteristic("2a05", BLEIndicate),
 
-  _central(this)
+  _central(this),
+  _socEventHandler(NULL)
 {
 #if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
   this->_device = &this->_nRF51822;
@@ -59,12 +62,9 @@ BLEPeripheral::BLEPeripheral(unsigned char req, unsigned char rdy, unsigned char
 BLEPeripheral::~BLEPeripheral() {
   this->end();
 
-  if (this->_remoteAttributes) {
-    free(this->_remoteAttributes);
-  }
-
-  if (this->_localAttributes) {
-    free(this->_localAttributes);
+  if (this->_gattDatabase == NULL) {
+    this->deallocate(this->_remoteAttributes);
+    this->deallocate(this->_localAttributes);
   }
 }
 
@@ -168,10 +168,31 @@ void BLEPeripheral::begin() {
 
 void BLEPeripheral::poll(uint32_t *evtBuf, uint16_t* evtLen) {
   this->_device->poll(evtBuf, evtLen);
+
+  this->polled();
+}
+
+void BLEPeripheral::polled() {
 }
 
 void BLEPeripheral::end() {
   this->_device->end();
+
+  if (this->_gattDatabase) {
+    this->_gattDatabase->_deviceArena.reset();
+  }
+
+  if (this->_arena) {
+    this->_arena->reset();
+
+    if (this->_gattDatabase == NULL) {
+      // attribute tables lived in the arena, attributes must be added again before the next begin
+      this->_localAttributes = NULL;
+      this->_numLocalAttributes = 0;
+      this->_remoteAttributes = NULL;
+      this->_numRemoteAttributes = 0;
+    }
+  }
 }
 
 void BLEPeripheral::setAdvertisedServiceUuid(const char* advertisedServiceUuid) {
@@ -203,6 +224,44 @@ void BLEPeripheral::setBondStore(BLEBondStore& bondStore) {
   this->_device->setBondStore(bondStore);
 }
 
+void BLEPeripheral::setGattDatabase(BLEGattStorage& gattDatabase) {
+  // attributes added before the database was set are moved over to it
+  BLELocalAttribute** localAttributes = this->_localAttributes;
+  unsigned char numLocalAttributes = this->_numLocalAttributes;
+  BLERemoteAttribute** remoteAttributes = this->_remoteAttributes;
+  unsigned char numRemoteAttributes = this->_numRemoteAttributes;
+  bool ownsAttributes = (this->_gattDatabase == NULL);
+
+  this->_gattDatabase = &gattDatabase;
+
+  this->_remoteAttributes = gattDatabase._remoteAttributes;
+  this->_numRemoteAttributes = 0;
+
+  this->initLocalAttributes();
+
+  // the first entries are the built-in attributes, already added by initLocalAttributes
+  for (int i = BLE_NUM_BUILT_IN_LOCAL_ATTRIBUTES; i < numLocalAttributes; i++) {
+    this->addLocalAttribute(*localAttributes[i]);
+  }
+
+  for (int i = 0; i < numRemoteAttributes; i++) {
+    this->addRemoteAttribute(*remoteAttributes[i]);
+  }
+
+  if (ownsAttributes) {
+    this->deallocate(remoteAttributes);
+    this->deallocate(localAttributes);
+  }
+
+  this->_device->setArena(&gattDatabase._deviceArena);
+}
+
+void BLEPeripheral::setArena(BLEArena& arena) {
+  this->_arena = &arena;
+
+  this->_device->setArena(&arena);
+}
+
 void BLEPeripheral::setDeviceName(const char* deviceName) {
   this->_deviceNameCharacteristic.setValue(deviceName);
 }
@@ -219,26 +278,68 @@ uint32_t BLEPeripheral::stopAdvertise(){
   return this->_device->stopAdvertise();
 }
 
-void BLEPeripheral::addAttribute(BLELocalAttribute& attribute) {
-  this->addLocalAttribute(attribute);
+bool BLEPeripheral::addAttribute(BLELocalAttribute& attribute) {
+  return this->addLocalAttribute(attribute);
 }
 
-void BLEPeripheral::addLocalAttribute(BLELocalAttribute& localAttribute) {
+bool BLEPeripheral::addLocalAttribute(BLELocalAttribute& localAttribute) {
   if (this->_localAttributes == NULL) {
     this->initLocalAttributes();
+
+    if (this->_localAttributes == NULL) {
+      return false;
+    }
+  }
+
+  if (this->_gattDatabase) {
+    if (this->_numLocalAttributes >= this->_gattDatabase->_maxLocalAttributes) {
+#ifdef BLE_PERIPHERAL_DEBUG
+      Serial.println(F("Peripheral GATT database full, attribute ignored"));
+#endif
+      return false;
+    }
+
+    if (localAttribute.type() == BLETypeCharacteristic) {
+      if (this->_gattDatabase->_numLocalCharacteristics >= this->_gattDatabase->_maxLocalCharacteristics) {
+#ifdef BLE_PERIPHERAL_DEBUG
+        Serial.println(F("Peripheral GATT database full, characteristic ignored"));
+#endif
+        return false;
+      }
+
+      this->_gattDatabase->_numLocalCharacteristics++;
+    }
   }
 
   this->_localAttributes[this->_numLocalAttributes] = &localAttribute;
   this->_numLocalAttributes++;
+
+  return true;
 }
 
-void BLEPeripheral::addRemoteAttribute(BLERemoteAttribute& remoteAttribute) {
+bool BLEPeripheral::addRemoteAttribute(BLERemoteAttribute& remoteAttribute) {
   if (this->_remoteAttributes == NULL) {
-    this->_remoteAttributes = (BLERemoteAttribute**)malloc(BLERemoteAttribute::numAttributes() * sizeof(BLERemoteAttribute*));
+    this->_remoteAttributes = (BLERemoteAttribute**)this->allocate(BLERemoteAttribute::numAttributes() * sizeof(BLERemoteAttribute*));
+
+    if (this->_remoteAttributes == NULL) {
+#ifdef BLE_PERIPHERAL_DEBUG
+      Serial.println(F("Peripheral out of memory for remote attributes"));
+#endif
+      return false;
+    }
+  }
+
+  if (this->_gattDatabase && this->_numRemoteAttributes >= this->_gattDatabase->_maxRemoteAttributes) {
+#ifdef BLE_PERIPHERAL_DEBUG
+    Serial.println(F("Peripheral GATT database full, remote attribute ignored"));
+#endif
+    return false;
   }
 
   this->_remoteAttributes[this->_numRemoteAttributes] = &remoteAttribute;
   this->_numRemoteAttributes++;
+
+  return true;
 }
 
 void BLEPeripheral::setAdvertisingInterval(unsigned short advertisingInterval) {
@@ -249,6 +350,18 @@ void BLEPeripheral::setConnectionInterval(unsigned short minimumConnectionInterv
   this->_device->setConnectionInterval(minimumConnectionInterval, maximumConnectionInterval);
 }
 
+void BLEPeripheral::setAdvertisingTimeout(unsigned short advertisingTimeout) {
+  this->_device->setAdvertisingTimeout(advertisingTimeout);
+}
+
+void BLEPeripheral::setSleepInterval(unsigned long sleepInterval) {
+  this->_device->setSleepInterval(sleepInterval);
+}
+
+void BLEPeripheral::setAppLatency(unsigned short appLatency, unsigned short appLatencyIdleTime) {
+  this->_device->setAppLatency(appLatency, appLatencyIdleTime);
+}
+
 void BLEPeripheral::disconnect() {
   this->_device->disconnect();
 }
@@ -265,12 +378,38 @@ bool BLEPeripheral::connected() {
   return this->_central;
 }
 
+unsigned long BLEPeripheral::txThroughput() {
+  return this->_device->txThroughput();
+}
+
+unsigned long BLEPeripheral::powerStateTime(BLEPowerState state) {
+  return this->_device->powerStateTime(state);
+}
+
 void BLEPeripheral::setEventHandler(BLEPeripheralEvent event, BLEPeripheralEventHandler eventHandler) {
   if (event < sizeof(this->_eventHandlers)) {
     this->_eventHandlers[event] = eventHandler;
   }
 }
 
+void BLEPeripheral::setSocEventHandler(BLESocEventHandler socEventHandler) {
+  this->_socEventHandler = socEventHandler;
+}
+
+BLEArena* BLEPeripheral::arena() {
+  return this->_arena;
+}
+
+void* BLEPeripheral::allocate(size_t size) {
+  return (this->_arena) ? this->_arena->allocate(size) : malloc(size);
+}
+
+void BLEPeripheral::deallocate(void* ptr) {
+  if (ptr && this->_arena == NULL) {
+    free(ptr);
+  }
+}
+
 bool BLEPeripheral::characteristicValueChanged(BLECharacteristic& characteristic) {
   return this->_device->updateCharacteristicValue(characteristic);
 }
@@ -400,8 +539,28 @@ void BLEPeripheral::BLEDeviceTemperatureReceived(BLEDevice& /*device*/, float /*
 void BLEPeripheral::BLEDeviceBatteryLevelReceived(BLEDevice& /*device*/, float /*batteryLevel*/) {
 }
 
+void BLEPeripheral::BLEDeviceSocEventReceived(BLEDevice& /*device*/, unsigned long evtId) {
+  if (this->_socEventHandler) {
+    this->_socEventHandler(evtId);
+  }
+}
+
 void BLEPeripheral::initLocalAttributes() {
-  this->_localAttributes = (BLELocalAttribute**)malloc(BLELocalAttribute::numAttributes() * sizeof(BLELocalAttribute*));
+  if (this->_gattDatabase) {
+    this->_localAttributes = this->_gattDatabase->_localAttributes;
+    this->_gattDatabase->_numLocalCharacteristics = 0;
+  } else {
+    this->_localAttributes = (BLELocalAttribute**)this->allocate(BLELocalAttribute::numAttributes() * sizeof(BLELocalAttribute*));
+  }
+
+  this->_numLocalAttributes = 0;
+
+  if (this->_localAttributes == NULL) {
+#ifdef BLE_PERIPHERAL_DEBUG
+    Serial.println(F("Peripheral out of memory for attributes"));
+#endif
+    return;
+  }
 
   this->_localAttributes[0] = &this->_genericAccessService;
   this->_localAttributes[1] = &this->_deviceNameCharacteristic;
@@ -410,5 +569,5 @@ void BLEPeripheral::initLocalAttributes() {
   this->_localAttributes[3] = &this->_genericAttributeService;
   this->_localAttributes[4] = &this->_servicesChangedCharacteristic;
 
-  this->_numLocalAttributes = 5;
+  this->_numLocalAttributes = BLE_NUM_BUILT_IN_LOCAL_ATTRIBUTES;
 }
@@ -12,13 +12,16 @@
 #include "BLEDescriptor.h"
 #include "BLEDevice.h"
 #include "BLEFixedLengthCharacteristic.h"
+#include "BLEGattDatabase.h"
 #include "BLELocalAttribute.h"
 #include "BLEProgmemConstantCharacteristic.h"
 #include "BLERemoteAttribute.h"
 #include "BLERemoteCharacteristic.h"
 #include "BLERemoteService.h"
 #include "BLEService.h"
+#include "BLEStaticCharacteristic.h"
 #include "BLETypedCharacteristics.h"
+#include "BLEUserLocatedCharacteristic.h"
 
 #if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
   #include "nRF51822.h"
@@ -48,6 +51,7 @@ enum BLEPeripheralEvent {
 };
 
 typedef void (*BLEPeripheralEventHandler)(BLECentral& central);
+typedef void (*BLESocEventHandler)(unsigned long evtId);
 
 class BLEPeripheral : public BLEDeviceEventListener,
                         public BLECharacteristicValueChangeListener,
@@ -71,8 +75,13 @@ class BLEPeripheral : public BLEDeviceEventListener,
     // must be between  0x0006 (7.5 ms) and 0x0c80 (4 s), values outside of this range will be ignored
     void setConnectionInterval(unsigned short minimumConnectionInterval, unsigned short maximumConnectionInterval);
     bool setTxPower(int txPower);
+    void setAdvertisingTimeout(unsigned short advertisingTimeout);
+    void setSleepInterval(unsigned long sleepInterval);
+    void setAppLatency(unsigned short appLatency, unsigned short appLatencyIdleTime);
     void setConnectable(bool connectable);
     void setBondStore(BLEBondStore& bondStore);
+    void setGattDatabase(BLEGattStorage& gattDatabase);
+    void setArena(BLEArena& arena);
 
 
     void setDeviceName(const char* deviceName);
@@ -81,18 +90,26 @@ class BLEPeripheral : public BLEDeviceEventListener,
     uint32_t startAdvertising();
     uint32_t stopAdvertise();
 
-    void addAttribute(BLELocalAttribute& attribute);
-    void addLocalAttribute(BLELocalAttribute& localAttribute);
-    void addRemoteAttribute(BLERemoteAttribute& remoteAttribute);
+    bool addAttribute(BLELocalAttribute& attribute);
+    bool addLocalAttribute(BLELocalAttribute& localAttribute);
+    bool addRemoteAttribute(BLERemoteAttribute& remoteAttribute);
 
     void disconnect();
 
     BLECentral central();
     bool connected();
+    unsigned long txThroughput();
+    unsigned long powerStateTime(BLEPowerState state);
 
     void setEventHandler(BLEPeripheralEvent event, BLEPeripheralEventHandler eventHandler);
+    // nRF51/52 SoC events the bond store reads on the way to its own flash events
+    void setSocEventHandler(BLESocEventHandler socEventHandler);
 
   protected:
+    BLEArena* arena();
+    void* allocate(size_t size);
+    void deallocate(void* ptr);
+
     bool characteristicValueChanged(BLECharacteristic& characteristic);
     bool broadcastCharacteristic(BLECharacteristic& characteristic);
     bool canNotifyCharacteristic(BLECharacteristic& characteristic);
@@ -107,6 +124,9 @@ class BLEPeripheral : public BLEDeviceEventListener,
     bool canUnsubscribeRemoteCharacteristic(BLERemoteCharacteristic& characteristic);
     bool unsubcribeRemoteCharacteristic(BLERemoteCharacteristic& characteristic);
 
+    // runs after every poll, whichever object the sketch polls through
+    virtual void polled();
+
     virtual void BLEDeviceConnected(BLEDevice& device, const unsigned char* address);
     virtual void BLEDeviceDisconnected(BLEDevice& device);
     virtual void BLEDeviceBonded(BLEDevice& device);
@@ -120,6 +140,7 @@ class BLEPeripheral : public BLEDeviceEventListener,
     virtual void BLEDeviceAddressReceived(BLEDevice& device, const unsigned char* address);
     virtual void BLEDeviceTemperatureReceived(BLEDevice& device, float temperature);
     virtual void BLEDeviceBatteryLevelReceived(BLEDevice& device, float batteryLevel);
+    virtual void BLEDeviceSocEventReceived(BLEDevice& device, unsigned long evtId);
 
   private:
     void initLocalAttributes();
@@ -139,22 +160,25 @@ class BLEPeripheral : public BLEDeviceEventListener,
     unsigned char                  _manufacturerDataLength;
     const char*                    _localName;
 
+    BLEGattStorage*                _gattDatabase;
+    BLEArena*                      _arena;
     BLELocalAttribute**            _localAttributes;
     unsigned char                  _numLocalAttributes;
     BLERemoteAttribute**           _remoteAttributes;
     unsigned char                  _numRemoteAttributes;
 
     BLEService                     _genericAccessService;
-    BLECharacteristic              _deviceNameCharacteristic;
-    BLECharacteristic              _appearanceCharacteristic;
+    BLEStaticCharacteristic<19>    _deviceNameCharacteristic;
+    BLEStaticCharacteristic<2>     _appearanceCharacteristic;
     BLEService                     _genericAttributeService;
-    BLECharacteristic              _servicesChangedCharacteristic;
+    BLEStaticCharacteristic<4>     _servicesChangedCharacteristic;
 
     BLERemoteService               _remoteGenericAttributeService;
     BLERemoteCharacteristic        _remoteServicesChangedCharacteristic;
 
     BLECentral                     _central;
     BLEPeripheralEventHandler      _eventHandlers[4];
+    BLESocEventHandler             _socEventHandler;
 };
 
 #endif
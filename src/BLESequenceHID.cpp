@@ -0,0 +1,151 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "BLESequenceHID.h"
+
+BLESequenceHID::BLESequenceHID(const unsigned char* descriptor, unsigned char descriptorLength, unsigned char reportIdOffset) :
+  BLEHID(descriptor, descriptorLength, reportIdOffset),
+  _keyHead(0),
+  _numKeys(0),
+  _holdKey(0),
+  _holdPressed(false),
+  _holdRepeating(false),
+  _releasePending(false),
+  _holdTime(0),
+  _repeatDelay(0),
+  _repeatInterval(0)
+{
+}
+
+size_t BLESequenceHID::write(uint8_t k) {
+  return this->writeSequence(&k, 1);
+}
+
+size_t BLESequenceHID::writeSequence(const uint8_t keys[], size_t count) {
+  size_t written = 0;
+
+  if (!this->connected()) {
+    return 0;
+  }
+
+  while (written < count && this->_numKeys < BLE_HID_KEY_SEQUENCE_SIZE) {
+    this->_keys[(this->_keyHead + this->_numKeys) % BLE_HID_KEY_SEQUENCE_SIZE] = keys[written];
+    this->_numKeys++;
+
+    written++;
+  }
+
+  // whatever fits in the report queue goes out now, the rest from poll()
+  this->sendKeys();
+
+  return written;
+}
+
+void BLESequenceHID::hold(uint8_t k, unsigned long repeatDelay, unsigned long repeatInterval) {
+  if (!this->connected()) {
+    return;
+  }
+
+  this->_holdKey = k;
+  this->_holdPressed = false;
+  this->_repeatDelay = repeatDelay;
+  this->_repeatInterval = repeatInterval;
+
+  this->sendKeys();
+}
+
+void BLESequenceHID::release() {
+  if (this->_holdPressed) {
+    this->_releasePending = true;
+  }
+
+  this->_holdKey = 0;
+  this->_holdPressed = false;
+
+  this->sendKeys();
+}
+
+unsigned char BLESequenceHID::pendingKeys() {
+  return this->_numKeys;
+}
+
+void BLESequenceHID::poll() {
+  if (!this->connected()) {
+    // keys meant for the old connection, don't fire them on the next one
+    this->clearKeys();
+    return;
+  }
+
+  this->sendKeys();
+}
+
+size_t BLESequenceHID::sendKeys() {
+  size_t sent = 0;
+
+  if (this->_releasePending) {
+    if (!this->sendKey(0)) {
+      return 0;
+    }
+
+    this->_releasePending = false;
+  }
+
+  // press and release back to back, only when both fit so no key is left pressed
+  while (this->_numKeys && this->canSendData(2)) {
+    if (!this->sendKey(this->_keys[this->_keyHead])) {
+      // not queued, stays first in line
+      break;
+    }
+
+    this->_keyHead = (this->_keyHead + 1) % BLE_HID_KEY_SEQUENCE_SIZE;
+    this->_numKeys--;
+    sent++;
+
+    // the report holds one key, a held key was released by this one
+    this->_holdPressed = false;
+
+    if (!this->sendKey(0)) {
+      // pressed already, the release goes first next time
+      this->_releasePending = true;
+      break;
+    }
+  }
+
+  if (this->_numKeys || this->_holdKey == 0 || this->_releasePending) {
+    return sent;
+  }
+
+  unsigned long now = millis();
+
+  if (!this->_holdPressed) {
+    if (this->sendKey(this->_holdKey)) {
+      this->_holdPressed = true;
+      this->_holdRepeating = false;
+      this->_holdTime = now;
+    }
+  } else if ((now - this->_holdTime) >= (this->_holdRepeating ? this->_repeatInterval : this->_repeatDelay) && this->canSendData(2)) {
+    if (!this->sendKey(0)) {
+      return sent;
+    }
+
+    if (!this->sendKey(this->_holdKey)) {
+      // released, pressed again on the next try
+      this->_holdPressed = false;
+      return sent;
+    }
+
+    this->_holdRepeating = true;
+    this->_holdTime = now;
+  }
+
+  return sent;
+}
+
+void BLESequenceHID::clearKeys() {
+  this->_keyHead = 0;
+  this->_numKeys = 0;
+
+  this->_holdKey = 0;
+  this->_holdPressed = false;
+  this->_releasePending = false;
+}
@@ -0,0 +1,55 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef _BLE_SEQUENCE_HID_H_
+#define _BLE_SEQUENCE_HID_H_
+
+#include "Arduino.h"
+
+#include "BLEHID.h"
+
+// keys waiting to be sent as press/release pairs
+#ifndef BLE_HID_KEY_SEQUENCE_SIZE
+#define BLE_HID_KEY_SEQUENCE_SIZE 16
+#endif
+
+// HID with a single key usage per report, like the consumer and system control keys
+class BLESequenceHID : public BLEHID
+{
+  public:
+    size_t write(uint8_t k);
+    size_t writeSequence(const uint8_t keys[], size_t count);
+
+    // keep k pressed and repeat it until release()
+    void hold(uint8_t k, unsigned long repeatDelay = 500, unsigned long repeatInterval = 100);
+    void release();
+
+    unsigned char pendingKeys();
+
+  protected:
+    BLESequenceHID(const unsigned char* descriptor, unsigned char descriptorLength, unsigned char reportIdOffset);
+
+    // report with only k pressed, 0 releases
+    virtual bool sendKey(uint8_t k) = 0;
+
+    virtual void poll();
+
+  private:
+    // usages from the sequence queued as press/release pairs, stops at the first report that didn't fit
+    size_t sendKeys();
+    void clearKeys();
+
+    uint8_t           _keys[BLE_HID_KEY_SEQUENCE_SIZE];
+    unsigned char     _keyHead;
+    unsigned char     _numKeys;
+
+    uint8_t           _holdKey;
+    bool              _holdPressed;
+    bool              _holdRepeating;
+    bool              _releasePending;
+    unsigned long     _holdTime;
+    unsigned long     _repeatDelay;
+    unsigned long     _repeatInterval;
+};
+
+#endif
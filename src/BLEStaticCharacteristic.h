@@ -0,0 +1,31 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef _BLE_STATIC_CHARACTERISTIC_H_
+#define _BLE_STATIC_CHARACTERISTIC_H_
+
+#include "Arduino.h"
+
+#include "BLECharacteristic.h"
+
+template<unsigned char VALUE_SIZE> class BLEStaticCharacteristic : public BLECharacteristic
+{
+  public:
+    BLEStaticCharacteristic(const char* uuid, unsigned char properties);
+
+    virtual ~BLEStaticCharacteristic();
+
+  private:
+    unsigned char _valueBuffer[VALUE_SIZE];
+};
+
+template<unsigned char VALUE_SIZE> BLEStaticCharacteristic<VALUE_SIZE>::BLEStaticCharacteristic(const char* uuid, unsigned char properties) :
+  BLECharacteristic(uuid, properties, this->_valueBuffer, VALUE_SIZE)
+{
+}
+
+template<unsigned char VALUE_SIZE> BLEStaticCharacteristic<VALUE_SIZE>::~BLEStaticCharacteristic() {
+  this->_value = NULL; // null so super destructor doesn't try to free
+}
+
+#endif
@@ -26,26 +26,18 @@ static const PROGMEM unsigned char descriptorValue[] = {
 };
 
 BLESystemControl::BLESystemControl() :
-  BLEHID(descriptorValue, sizeof(descriptorValue), 7),
+  BLESequenceHID(descriptorValue, sizeof(descriptorValue), 7),
   _reportCharacteristic("2a4d", BLERead | BLENotify, 4),
   _reportReferenceDescriptor(BLEHIDDescriptorTypeInput)
 {
 }
 
-size_t BLESystemControl::write(uint8_t k) {
+bool BLESystemControl::sendKey(uint8_t k) {
   uint8_t sysCtrlKeyPress[1]= { 0x00 };
 
-  // send key code
   sysCtrlKeyPress[0] = k;
 
-  for (int i = 0; i < 2; i++) {
-    this->sendData(this->_reportCharacteristic, sysCtrlKeyPress, sizeof(sysCtrlKeyPress));
-
-    // send cleared code
-    sysCtrlKeyPress[0] = 0x00;
-  }
-
-  return 1;
+  return this->sendData(this->_reportCharacteristic, sysCtrlKeyPress, sizeof(sysCtrlKeyPress));
 }
 
 void BLESystemControl::setReportId(unsigned char reportId) {
@@ -8,7 +8,7 @@
 
 #include "BLECharacteristic.h"
 #include "BLEHIDReportReferenceDescriptor.h"
-#include "BLEHID.h"
+#include "BLESequenceHID.h"
 
 // From: https://github.com/adafruit/Adafruit-Trinket-USB/blob/master/TrinketHidCombo/TrinketHidCombo.h
 //       permission to use under MIT license by @ladyada (https://github.com/adafruit/Adafruit-Trinket-USB/issues/10)
@@ -18,14 +18,14 @@
 #define SYSCTRLKEY_SLEEP    0x02
 #define SYSCTRLKEY_WAKE     0x03
 
-class BLESystemControl : public BLEHID
+class BLESystemControl : public BLESequenceHID
 {
   public:
     BLESystemControl();
 
-    size_t write(uint8_t k);
-
   protected:
+    virtual bool sendKey(uint8_t k);
+
     virtual void setReportId(unsigned char reportId);
     virtual unsigned char numAttributes();
     virtual BLELocalAttribute** attributes();
@@ -13,6 +13,8 @@ template<typename T> class BLETypedCharacteristic : public BLEFixedLengthCharact
   public:
     BLETypedCharacteristic(const char* uuid, unsigned char properties);
 
+    virtual ~BLETypedCharacteristic();
+
     bool setValue(T value);
     T value();
 
@@ -24,10 +26,12 @@ template<typename T> class BLETypedCharacteristic : public BLEFixedLengthCharact
 
   private:
     T byteSwap(T value);
+
+    unsigned char _valueBuffer[sizeof(T)];
 };
 
 template<typename T> BLETypedCharacteristic<T>::BLETypedCharacteristic(const char* uuid, unsigned char properties) :
-  BLEFixedLengthCharacteristic(uuid, properties, sizeof(T))
+  BLEFixedLengthCharacteristic(uuid, properties, this->_valueBuffer, sizeof(T))
 {
   T value;
   memset(&value, 0x00, sizeof(value));
@@ -35,6 +39,10 @@ template<typename T> BLETypedCharacteristic<T>::BLETypedCharacteristic(const cha
   this->setValue(value);
 }
 
+template<typename T> BLETypedCharacteristic<T>::~BLETypedCharacteristic() {
+  this->_value = NULL; // null so super destructor doesn't try to free
+}
+
 template<typename T> bool BLETypedCharacteristic<T>::setValue(T value) {
   return this->BLECharacteristic::setValue((unsigned char*)&value, sizeof(T));
 }
@@ -0,0 +1,33 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "BLEUserLocatedCharacteristic.h"
+
+BLEUserLocatedCharacteristic::BLEUserLocatedCharacteristic(const char* uuid, unsigned char properties, unsigned char value[], unsigned char valueSize, bool fixedLength) :
+  BLECharacteristic(uuid, properties, value, valueSize),
+  _fixedLength(fixedLength)
+{
+  if (fixedLength) {
+    this->_valueLength = valueSize;
+  }
+}
+
+BLEUserLocatedCharacteristic::~BLEUserLocatedCharacteristic() {
+  this->_value = NULL; // null so super destructor doesn't try to free
+}
+
+bool BLEUserLocatedCharacteristic::fixedLength() const {
+  return this->_fixedLength;
+}
+
+bool BLEUserLocatedCharacteristic::userLocated() const {
+  return true;
+}
+
+bool BLEUserLocatedCharacteristic::setValueLength(unsigned char length) {
+  if (this->_fixedLength) {
+    length = this->_valueSize;
+  }
+
+  return this->setValue(this->_value, length);
+}
@@ -0,0 +1,29 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef _BLE_USER_LOCATED_CHARACTERISTIC_H_
+#define _BLE_USER_LOCATED_CHARACTERISTIC_H_
+
+#include "Arduino.h"
+
+#include "BLECharacteristic.h"
+
+// value lives in an application buffer that the radio reads directly (nRF51822: BLE_GATTS_VLOC_USER),
+// update the buffer in place and call setValueLength to publish it, a fixed length value is always valueSize long
+class BLEUserLocatedCharacteristic : public BLECharacteristic
+{
+  public:
+    BLEUserLocatedCharacteristic(const char* uuid, unsigned char properties, unsigned char value[], unsigned char valueSize, bool fixedLength = false);
+
+    virtual ~BLEUserLocatedCharacteristic();
+
+    virtual bool fixedLength() const;
+    virtual bool userLocated() const;
+
+    bool setValueLength(unsigned char length);
+
+  private:
+    bool _fixedLength;
+};
+
+#endif
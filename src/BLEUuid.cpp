@@ -4,25 +4,27 @@
 #include "Arduino.h"
 
 #include "BLEUuid.h"
+#include "BLEVendorUuidTable.h"
 
 BLEUuid::BLEUuid(const char * str) :
-  _str(str)
+  _str(str),
+  _length(0)
 {
-  char temp[] = {0, 0, 0};
+  bool highNibble = false;
 
-  this->_length = 0;
-  for (int i = strlen(str) - 1; i >= 0 && this->_length < MAX_UUID_LENGTH; i -= 2) {
+  for (int i = strlen(str) - 1; i >= 0 && this->_length < MAX_UUID_LENGTH; i--) {
     if (str[i] == '-') {
-      i++;
       continue;
     }
 
-    temp[0] = str[i - 1];
-    temp[1] = str[i];
-
-    this->_data[this->_length] = strtoul(temp, NULL, 16);
+    if (highNibble) {
+      this->_data[this->_length] |= (hexValue(str[i]) << 4);
+      this->_length++;
+    } else {
+      this->_data[this->_length] = hexValue(str[i]);
+    }
 
-    this->_length++;
+    highNibble = !highNibble;
   }
 }
 
@@ -37,3 +39,13 @@ const unsigned char* BLEUuid::data() const {
 unsigned char BLEUuid::length() const {
   return this->_length;
 }
+
+#if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
+ble_uuid_t BLEUuid::get_nordic_uuid() {
+  ble_uuid_t nordicUuid;
+
+  BLEVendorUuidTable::resolve(this->_data, this->_length, &nordicUuid);
+
+  return nordicUuid;
+}
+#endif
@@ -20,6 +20,12 @@ class BLEUuid
     ble_uuid_t get_nordic_uuid();
 
   private:
+    static unsigned char hexValue(char c) {
+      return (c >= '0' && c <= '9') ? (c - '0') :
+              (c >= 'a' && c <= 'f') ? (c - 'a' + 10) :
+              (c >= 'A' && c <= 'F') ? (c - 'A' + 10) : 0;
+    }
+
     const char*    _str;
     unsigned char _data[MAX_UUID_LENGTH];
     unsigned char _length;
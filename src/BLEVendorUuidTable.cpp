@@ -0,0 +1,71 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
+
+#include "Arduino.h"
+
+#include "BLEVendorUuidTable.h"
+
+unsigned char BLEVendorUuidTable::_bases[BLE_VS_UUID_COUNT][16];
+uint8_t       BLEVendorUuidTable::_types[BLE_VS_UUID_COUNT];
+unsigned char BLEVendorUuidTable::_numBases = 0;
+unsigned char BLEVendorUuidTable::_failures = 0;
+
+uint32_t BLEVendorUuidTable::resolve(const unsigned char uuid[], unsigned char length, ble_uuid_t* nordicUuid) {
+  if (length == 2) {
+    nordicUuid->uuid = (uuid[1] << 8) | uuid[0];
+    nordicUuid->type = BLE_UUID_TYPE_BLE;
+
+    return NRF_SUCCESS;
+  }
+
+  unsigned char base[16];
+
+  memcpy(base, uuid, sizeof(base));
+
+  nordicUuid->uuid = (uuid[13] << 8) | uuid[12];
+
+  base[13] = 0;
+  base[12] = 0;
+
+  for (unsigned char i = 0; i < _numBases; i++) {
+    if (memcmp(_bases[i], base, sizeof(base)) == 0) {
+      nordicUuid->type = _types[i];
+
+      return NRF_SUCCESS;
+    }
+  }
+
+  uint32_t result = sd_ble_uuid_vs_add((ble_uuid128_t*)&base, &nordicUuid->type);
+
+  if (result != NRF_SUCCESS) {
+    nordicUuid->type = BLE_UUID_TYPE_UNKNOWN;
+    _failures++;
+  } else if (_numBases < BLE_VS_UUID_COUNT) {
+    memcpy(_bases[_numBases], base, sizeof(base));
+    _types[_numBases] = nordicUuid->type;
+    _numBases++;
+  }
+
+  return result;
+}
+
+void BLEVendorUuidTable::reset() {
+  _numBases = 0;
+  _failures = 0;
+}
+
+unsigned char BLEVendorUuidTable::used() {
+  return _numBases;
+}
+
+unsigned char BLEVendorUuidTable::capacity() {
+  return BLE_VS_UUID_COUNT;
+}
+
+unsigned char BLEVendorUuidTable::failures() {
+  return _failures;
+}
+
+#endif
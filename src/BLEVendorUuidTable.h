@@ -0,0 +1,43 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef _BLE_VENDOR_UUID_TABLE_H_
+#define _BLE_VENDOR_UUID_TABLE_H_
+
+#if defined(NRF51) || defined(NRF52) || defined(__RFduino__)
+
+#ifdef __RFduino__
+#include <utility/RFduino/ble.h>
+#elif defined(NRF5) || defined(NRF51_S130)
+#include <ble.h>
+#else
+#include <s110/ble.h>
+#endif
+
+// number of vendor specific UUID bases reserved in the SoftDevice
+#ifndef BLE_VS_UUID_COUNT
+#define BLE_VS_UUID_COUNT 5
+#endif
+
+// 128-bit UUID bases registered with the SoftDevice, shared by the peripheral and central roles,
+// so attributes with the same base use a single SoftDevice slot
+class BLEVendorUuidTable
+{
+  public:
+    static uint32_t resolve(const unsigned char uuid[], unsigned char length, ble_uuid_t* nordicUuid);
+    static void reset();
+
+    static unsigned char used();
+    static unsigned char capacity();
+    static unsigned char failures();
+
+  private:
+    static unsigned char    _bases[BLE_VS_UUID_COUNT][16];
+    static uint8_t          _types[BLE_VS_UUID_COUNT];
+    static unsigned char    _numBases;
+    static unsigned char    _failures;
+};
+
+#endif
+
+#endif
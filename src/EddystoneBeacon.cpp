@@ -3,54 +3,85 @@
 
 #include "EddystoneBeacon.h"
 
-#define MAX_SERVICE_DATA_SIZE 20
+#define MAX_SERVICE_DATA_SIZE EDDYSTONE_MAX_SERVICE_DATA_SIZE
+#define TLM_FRAME_SIZE        14
+
+#define DEFAULT_ADVERTISING_INTERVAL  100
+#define DEFAULT_FRAME_INTERVAL        1000
 
 #define FLAGS_UID 0x00
 #define FLAGS_URL 0x10
 #define FLAGS_TLM 0x20
 
-static const char* EDDYSTONE_URL_BEACON_PREFIX_SUBSTITUTIONS[] = {
-  "http://www.",
-  "https://www.",
-  "http://",
-  "https://",
-  "urn:uuid:"
-};
-
-static const char* EDDYSTONE_URL_BEACON_SUFFIX_SUBSTITUTIONS[] = {
-  ".com/",
-  ".org/",
-  ".edu/",
-  ".net/",
-  ".info/",
-  ".biz/",
-  ".gov/",
-  ".com",
-  ".org",
-  ".edu",
-  ".net",
-  ".info",
-  ".biz",
-  ".gov"
-};
-
 EddystoneBeacon::EddystoneBeacon(unsigned char req, unsigned char rdy, unsigned char rst) :
   BLEPeripheral(req, rdy, rst),
   _bleService("feaa"),
-  _bleCharacteristic("feab", BLERead | BLEBroadcast, MAX_SERVICE_DATA_SIZE)
+  _bleCharacteristic("feab", BLERead | BLEBroadcast, MAX_SERVICE_DATA_SIZE),
+  _frameIndex(EDDYSTONE_NUM_FRAMES),
+  _frameCount(0),
+  _frameInterval(DEFAULT_FRAME_INTERVAL),
+  _frameTime(0),
+  _advertisingInterval(DEFAULT_ADVERTISING_INTERVAL),
+  _tlmTime(0),
+  _advCount(0),
+  _advRemainder(0),
+  _secCount(0),
+  _secRemainder(0)
 {
   this->setConnectable(false);
 
   this->addAttribute(this->_bleService);
   this->addAttribute(this->_bleCharacteristic);
+
+  memset(this->_frames, 0x00, sizeof(this->_frames));
+
+  this->_frames[EddystoneFrameUID].ratio = 1;
+  this->_frames[EddystoneFrameURL].ratio = 1;
+
+  // TLM is always ready, but only sent once given a ratio
+  this->_frames[EddystoneFrameTLM].data[0] = FLAGS_TLM;
+  this->_frames[EddystoneFrameTLM].data[1] = 0x00; // version
+  this->_frames[EddystoneFrameTLM].data[4] = 0x80; // temperature not supported
+  this->_frames[EddystoneFrameTLM].length = TLM_FRAME_SIZE;
+}
+
+void EddystoneBeacon::begin(char power) {
+  this->_power = power;
+
+  this->_frames[EddystoneFrameUID].data[1] = power;
+  this->_frames[EddystoneFrameURL].data[1] = power;
+
+  this->_frameTime = this->_tlmTime = millis();
+
+  this->_frameIndex = EDDYSTONE_NUM_FRAMES - 1;
+  this->selectNextFrame();
+  this->broadcastFrame();
+
+  this->setAdvertisedServiceUuid(this->_bleService.uuid());
+
+  BLEPeripheral::begin();
+
+  this->_bleCharacteristic.broadcast();
 }
 
 void EddystoneBeacon::begin(char power, const BLEUuid& uid) {
-  unsigned char serviceData[MAX_SERVICE_DATA_SIZE];
+  this->_frames[EddystoneFrameURL].length = 0;
+  this->setUID(uid);
 
-  this->_power = power;
+  this->begin(power);
+}
+
+void EddystoneBeacon::begin(char power, const char* uri) {
+  this->_frames[EddystoneFrameUID].length = 0;
+  this->setURI(uri);
 
-  memset(serviceData, 0x00, sizeof(serviceData));
+  this->begin(power);
+}
+
+void EddystoneBeacon::setUID(const BLEUuid& uid) {
+  unsigned char* serviceData = this->_frames[EddystoneFrameUID].data;
+
+  memset(serviceData, 0x00, MAX_SERVICE_DATA_SIZE);
   serviceData[0] = FLAGS_UID;
   serviceData[1] = this->_power;
 
@@ -62,63 +93,173 @@ void EddystoneBeacon::begin(char power, const BLEUuid& uid) {
   serviceData[18] = 0x00; // Reserved for future use, must be: 0x00
   serviceData[19] = 0x00; // Reserved for future use, must be: 0x00
 
-  this->_bleCharacteristic.setValue(serviceData, sizeof(serviceData));
+  this->_frames[EddystoneFrameUID].length = MAX_SERVICE_DATA_SIZE;
 
-  this->setAdvertisedServiceUuid(this->_bleService.uuid());
-
-  BLEPeripheral::begin();
-
-  this->_bleCharacteristic.broadcast();
+  if (this->_frameIndex == EddystoneFrameUID) {
+    this->broadcastFrame();
+  }
 }
 
-void EddystoneBeacon::begin(char power, const char* uri) {
-  this->_power = power;
-  this->setURI(uri);
+void EddystoneBeacon::setURI(const char* uri) {
+  unsigned char* serviceData = this->_frames[EddystoneFrameURL].data;
 
-  this->setAdvertisedServiceUuid(this->_bleService.uuid());
+  serviceData[0] = FLAGS_URL;
+  serviceData[1] = this->_power;
+  unsigned char compressedURIlength = this->compressURI(uri, (char *)&serviceData[2], MAX_SERVICE_DATA_SIZE - 2);
 
-  BLEPeripheral::begin();
+  this->_frames[EddystoneFrameURL].length = 2 + compressedURIlength;
 
-  this->_bleCharacteristic.broadcast();
+  if (this->_frameIndex == EddystoneFrameURL) {
+    this->broadcastFrame();
+  }
 }
 
-void EddystoneBeacon::setURI(const char* uri) {
-  unsigned char serviceData[MAX_SERVICE_DATA_SIZE];
+void EddystoneBeacon::setURI(const EddystoneURL& url) {
+  unsigned char* serviceData = this->_frames[EddystoneFrameURL].data;
 
   serviceData[0] = FLAGS_URL;
   serviceData[1] = this->_power;
-  unsigned char compressedURIlength = this->compressURI(uri, (char *)&serviceData[2], sizeof(serviceData) - 2);
+  memcpy(&serviceData[2], url.data, url.length);
+
+  this->_frames[EddystoneFrameURL].length = 2 + url.length;
 
-  this->_bleCharacteristic.setValue(serviceData, 2 + compressedURIlength);
+  if (this->_frameIndex == EddystoneFrameURL) {
+    this->broadcastFrame();
+  }
 }
 
-unsigned char EddystoneBeacon::compressURI(const char* uri, char *compressedUri, unsigned char compressedUriSize) {
-  String uriString = uri;
+void EddystoneBeacon::setFrameRatio(EddystoneFrame frame, unsigned char ratio) {
+  this->_frames[frame].ratio = ratio;
+}
+
+void EddystoneBeacon::setFrameInterval(unsigned long frameInterval) {
+  this->_frameInterval = frameInterval;
+}
+
+void EddystoneBeacon::setAdvertisingInterval(unsigned short advertisingInterval) {
+  // kept for the TLM advertising count
+  this->_advertisingInterval = advertisingInterval;
+
+  BLEPeripheral::setAdvertisingInterval(advertisingInterval);
+}
+
+void EddystoneBeacon::setBatteryVoltage(unsigned short batteryVoltage) {
+  this->_frames[EddystoneFrameTLM].data[2] = batteryVoltage >> 8;
+  this->_frames[EddystoneFrameTLM].data[3] = batteryVoltage;
+}
+
+void EddystoneBeacon::setTemperature(float temperature) {
+  // signed 8.8 fixed point
+  int fixedTemperature = temperature * 256;
 
-  // replace prefixes
-  for (unsigned int i = 0; i < (sizeof(EDDYSTONE_URL_BEACON_PREFIX_SUBSTITUTIONS) / sizeof(char *)); i++) {
-    String replacement = " ";
-    replacement[0] = (char)(i | 0x80); // set high bit, String.replace does not like '\0' replacement
+  this->_frames[EddystoneFrameTLM].data[4] = fixedTemperature >> 8;
+  this->_frames[EddystoneFrameTLM].data[5] = fixedTemperature;
+}
+
+void EddystoneBeacon::nextFrame() {
+  this->_frameCount++;
 
-    uriString.replace(EDDYSTONE_URL_BEACON_PREFIX_SUBSTITUTIONS[i], replacement);
+  if (this->_frameCount < this->_frames[this->_frameIndex].ratio) {
+    return;
   }
 
-  // replace suffixes
-  for (unsigned int i = 0; i < (sizeof(EDDYSTONE_URL_BEACON_SUFFIX_SUBSTITUTIONS) / sizeof(char *)); i++) {
-    String replacement = " ";
-    replacement[0] = (char)(i | 0x80); // set high bit, String.replace does not like '\0' replacement
+  this->selectNextFrame();
+}
+
+void EddystoneBeacon::selectNextFrame() {
+  // next frame in UID, URL, TLM order that is set and has a ratio
+  for (unsigned char i = 1; i <= EDDYSTONE_NUM_FRAMES; i++) {
+    unsigned char frameIndex = (this->_frameIndex + i) % EDDYSTONE_NUM_FRAMES;
 
-    uriString.replace(EDDYSTONE_URL_BEACON_SUFFIX_SUBSTITUTIONS[i], replacement);
+    if (this->_frames[frameIndex].length && this->_frames[frameIndex].ratio) {
+      this->_frameIndex = frameIndex;
+      break;
+    }
   }
 
-  unsigned char i = 0;
-  for (i = 0; i < uriString.length() && i < compressedUriSize; i++) {
-    compressedUri[i] = (uriString[i] & 0x7f); // assign byte after clearing hight bit
+  this->_frameCount = 0;
+}
+
+void EddystoneBeacon::broadcastFrame() {
+  struct frame* frame = &this->_frames[this->_frameIndex];
+
+  if (this->_frameIndex == EddystoneFrameTLM) {
+    this->updateTLM();
   }
 
-  return i;
+  // swaps the service data in the running advertisement
+  this->_bleCharacteristic.setValue(frame->data, frame->length);
+}
+
+void EddystoneBeacon::updateTLM() {
+  unsigned long now = millis();
+  unsigned long elapsed = now - this->_tlmTime;
+  unsigned char* serviceData = this->_frames[EddystoneFrameTLM].data;
+
+  this->_tlmTime = now;
+
+  // counters advance by the time since the last TLM frame, remainders carry over
+  this->_secRemainder += elapsed;
+  this->_secCount += this->_secRemainder / 100;
+  this->_secRemainder %= 100;
+
+  if (this->_advertisingInterval) {
+    this->_advRemainder += elapsed;
+    this->_advCount += this->_advRemainder / this->_advertisingInterval;
+    this->_advRemainder %= this->_advertisingInterval;
+  }
+
+  for (int i = 0; i < 4; i++) {
+    serviceData[6 + i] = this->_advCount >> (24 - i * 8);
+    serviceData[10 + i] = this->_secCount >> (24 - i * 8);
+  }
+}
+
+unsigned char EddystoneBeacon::compressURI(const char* uri, char *compressedUri, unsigned char compressedUriSize) {
+  unsigned char length = 0;
+  unsigned int offset = 0;
+
+  // one pass straight into the frame, the prefix is only looked up at the start
+  // and the expansions only where a '.' is
+  unsigned char code = eddystoneURLPrefixCode(uri);
+
+  if (code != EDDYSTONE_URL_NO_CODE && compressedUriSize) {
+    compressedUri[length++] = code;
+    offset += eddystoneURLLength(eddystoneURLPrefix(code));
+  }
+
+  while (uri[offset] && length < compressedUriSize) {
+    code = eddystoneURLExpansionCode(&uri[offset]);
+
+    if (code != EDDYSTONE_URL_NO_CODE) {
+      compressedUri[length++] = code;
+      offset += eddystoneURLLength(eddystoneURLExpansion(code));
+    } else {
+      compressedUri[length++] = uri[offset++];
+    }
+  }
+
+  return length;
 }
 
 void EddystoneBeacon::loop() {
   this->poll();
+
+  if (this->_frameIndex == EDDYSTONE_NUM_FRAMES) {
+    return;
+  }
+
+  unsigned long now = millis();
+
+  if ((now - this->_frameTime) >= this->_frameInterval) {
+    unsigned char frameIndex = this->_frameIndex;
+
+    this->_frameTime = now;
+    this->nextFrame();
+
+    // a frame that stays only needs refreshing when it carries the TLM counters
+    if (this->_frameIndex != frameIndex || this->_frameIndex == EddystoneFrameTLM) {
+      this->broadcastFrame();
+    }
+  }
 }
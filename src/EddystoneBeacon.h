@@ -6,25 +6,73 @@
 
 #include "BLEPeripheral.h"
 #include "BLEUuid.h"
+#include "EddystoneURL.h"
+
+#define EDDYSTONE_MAX_SERVICE_DATA_SIZE 20
+
+enum EddystoneFrame {
+  EddystoneFrameUID = 0,
+  EddystoneFrameURL = 1,
+  EddystoneFrameTLM = 2
+};
+
+#define EDDYSTONE_NUM_FRAMES 3
 
 class EddystoneBeacon : public BLEPeripheral
 {
   public:
     EddystoneBeacon(unsigned char req = BLE_DEFAULT_REQ, unsigned char rdy = BLE_DEFAULT_RDY, unsigned char rst = BLE_DEFAULT_RST);
 
+    void begin(char power);
     void begin(char power, const BLEUuid& uid);
     void begin(char power, const char* uri);
     void loop();
 
+    void setUID(const BLEUuid& uid);
     void setURI(const char* uri);
+    // URL encoded ahead of time with EDDYSTONE_URL
+    void setURI(const EddystoneURL& url);
+
+    // frames advertised in a row before moving on to the next one, 0 leaves a frame out
+    void setFrameRatio(EddystoneFrame frame, unsigned char ratio);
+    void setFrameInterval(unsigned long frameInterval);
+    void setAdvertisingInterval(unsigned short advertisingInterval);
+
+    // TLM frame values, battery in mV, temperature in degrees C
+    void setBatteryVoltage(unsigned short batteryVoltage);
+    void setTemperature(float temperature);
 
   private:
+    struct frame {
+      unsigned char data[EDDYSTONE_MAX_SERVICE_DATA_SIZE];
+      unsigned char length;
+      unsigned char ratio;
+    };
+
     unsigned char compressURI(const char* uri, char *compressedUri, unsigned char compressedUriSize);
 
+    void nextFrame();
+    void selectNextFrame();
+    void broadcastFrame();
+    void updateTLM();
+
     char              _power;
 
     BLEService        _bleService;
     BLECharacteristic _bleCharacteristic;
+
+    struct frame      _frames[EDDYSTONE_NUM_FRAMES];
+    unsigned char     _frameIndex;
+    unsigned char     _frameCount;
+    unsigned long     _frameInterval;
+    unsigned long     _frameTime;
+
+    unsigned short    _advertisingInterval;
+    unsigned long     _tlmTime;
+    unsigned long     _advCount;
+    unsigned long     _advRemainder;
+    unsigned long     _secCount;
+    unsigned long     _secRemainder;
 };
 
 #endif
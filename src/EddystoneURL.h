@@ -0,0 +1,127 @@
+// Copyright (c) Sandeep Mistry. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef _EDDYSTONE_URL_H_
+#define _EDDYSTONE_URL_H_
+
+// encoded URL bytes that fit in a URL frame
+#define EDDYSTONE_URL_MAX_LENGTH      18
+
+#define EDDYSTONE_NUM_URL_PREFIXES    5
+#define EDDYSTONE_NUM_URL_EXPANSIONS  14
+#define EDDYSTONE_URL_NO_CODE         0xff
+
+#if __cplusplus >= 201103L
+#define EDDYSTONE_CONSTEXPR constexpr
+#else
+#define EDDYSTONE_CONSTEXPR
+#endif
+
+// the helpers below are constexpr so URL literals can be encoded at compile time,
+// the runtime encoder uses the same tables
+
+EDDYSTONE_CONSTEXPR inline const char* eddystoneURLPrefix(unsigned char code) {
+  return (code == 0) ? "http://www." :
+         (code == 1) ? "https://www." :
+         (code == 2) ? "http://" :
+         (code == 3) ? "https://" :
+                       "urn:uuid:";
+}
+
+// the ones ending in '/' come first so the longest expansion wins
+EDDYSTONE_CONSTEXPR inline const char* eddystoneURLExpansion(unsigned char code) {
+  return (code == 0)  ? ".com/" :
+         (code == 1)  ? ".org/" :
+         (code == 2)  ? ".edu/" :
+         (code == 3)  ? ".net/" :
+         (code == 4)  ? ".info/" :
+         (code == 5)  ? ".biz/" :
+         (code == 6)  ? ".gov/" :
+         (code == 7)  ? ".com" :
+         (code == 8)  ? ".org" :
+         (code == 9)  ? ".edu" :
+         (code == 10) ? ".net" :
+         (code == 11) ? ".info" :
+         (code == 12) ? ".biz" :
+                        ".gov";
+}
+
+EDDYSTONE_CONSTEXPR inline unsigned char eddystoneURLLength(const char* s, unsigned char i = 0) {
+  return (s[i] == 0) ? i : eddystoneURLLength(s, i + 1);
+}
+
+// true if uri starts with pattern
+EDDYSTONE_CONSTEXPR inline bool eddystoneURLMatch(const char* uri, const char* pattern) {
+  return (*pattern == 0) || ((*uri == *pattern) && eddystoneURLMatch(uri + 1, pattern + 1));
+}
+
+// prefixes only apply at the start of the URL, all of them begin with 'h' or 'u'
+EDDYSTONE_CONSTEXPR inline unsigned char eddystoneURLPrefixCode(const char* uri, unsigned char code = 0) {
+  return (code == EDDYSTONE_NUM_URL_PREFIXES || (uri[0] != 'h' && uri[0] != 'u')) ? EDDYSTONE_URL_NO_CODE :
+         eddystoneURLMatch(uri, eddystoneURLPrefix(code)) ? code :
+         eddystoneURLPrefixCode(uri, code + 1);
+}
+
+// expansions all begin with '.', anything else is copied without looking at the table
+EDDYSTONE_CONSTEXPR inline unsigned char eddystoneURLExpansionCode(const char* uri, unsigned char code = 0) {
+  return (code == EDDYSTONE_NUM_URL_EXPANSIONS || uri[0] != '.') ? EDDYSTONE_URL_NO_CODE :
+         eddystoneURLMatch(uri, eddystoneURLExpansion(code)) ? code :
+         eddystoneURLExpansionCode(uri, code + 1);
+}
+
+// encoded byte for the text at offset and how much of the text it covers
+EDDYSTONE_CONSTEXPR inline unsigned char eddystoneURLCode(const char* uri, unsigned char offset) {
+  return (offset == 0 && eddystoneURLPrefixCode(uri) != EDDYSTONE_URL_NO_CODE) ? eddystoneURLPrefixCode(uri) :
+         (eddystoneURLExpansionCode(uri + offset) != EDDYSTONE_URL_NO_CODE) ? eddystoneURLExpansionCode(uri + offset) :
+         uri[offset];
+}
+
+EDDYSTONE_CONSTEXPR inline unsigned char eddystoneURLCodeLength(const char* uri, unsigned char offset) {
+  return (offset == 0 && eddystoneURLPrefixCode(uri) != EDDYSTONE_URL_NO_CODE) ? eddystoneURLLength(eddystoneURLPrefix(eddystoneURLPrefixCode(uri))) :
+         (eddystoneURLExpansionCode(uri + offset) != EDDYSTONE_URL_NO_CODE) ? eddystoneURLLength(eddystoneURLExpansion(eddystoneURLExpansionCode(uri + offset))) :
+         1;
+}
+
+EDDYSTONE_CONSTEXPR inline unsigned char eddystoneURLOffset(const char* uri, unsigned char index, unsigned char offset = 0) {
+  return (index == 0 || uri[offset] == 0) ? offset : eddystoneURLOffset(uri, index - 1, offset + eddystoneURLCodeLength(uri, offset));
+}
+
+EDDYSTONE_CONSTEXPR inline unsigned char eddystoneURLEncodedLength(const char* uri, unsigned char offset = 0) {
+  return (uri[offset] == 0) ? 0 : 1 + eddystoneURLEncodedLength(uri, offset + eddystoneURLCodeLength(uri, offset));
+}
+
+EDDYSTONE_CONSTEXPR inline unsigned char eddystoneURLByte(const char* uri, unsigned char index) {
+  return (uri[eddystoneURLOffset(uri, index)] == 0) ? 0 : eddystoneURLCode(uri, eddystoneURLOffset(uri, index));
+}
+
+struct EddystoneURL {
+  unsigned char length;
+  unsigned char data[EDDYSTONE_URL_MAX_LENGTH];
+};
+
+// encodes a URL literal, at compile time when assigned to a constexpr EddystoneURL:
+//   constexpr EddystoneURL url = EDDYSTONE_URL("https://www.example.com/");
+#define EDDYSTONE_URL(uri) { \
+  (unsigned char)((eddystoneURLEncodedLength(uri) < EDDYSTONE_URL_MAX_LENGTH) ? eddystoneURLEncodedLength(uri) : EDDYSTONE_URL_MAX_LENGTH), { \
+    eddystoneURLByte(uri, 0), \
+    eddystoneURLByte(uri, 1), \
+    eddystoneURLByte(uri, 2), \
+    eddystoneURLByte(uri, 3), \
+    eddystoneURLByte(uri, 4), \
+    eddystoneURLByte(uri, 5), \
+    eddystoneURLByte(uri, 6), \
+    eddystoneURLByte(uri, 7), \
+    eddystoneURLByte(uri, 8), \
+    eddystoneURLByte(uri, 9), \
+    eddystoneURLByte(uri, 10), \
+    eddystoneURLByte(uri, 11), \
+    eddystoneURLByte(uri, 12), \
+    eddystoneURLByte(uri, 13), \
+    eddystoneURLByte(uri, 14), \
+    eddystoneURLByte(uri, 15), \
+    eddystoneURLByte(uri, 16), \
+    eddystoneURLByte(uri, 17) \
+  } \
+}
+
+#endif
@@ -17,6 +17,10 @@
 #include <s110/nrf_sdm.h>
 #endif
 
+#if defined(NRF51) || defined(NRF52)
+#include <nrf_soc.h>
+#endif
+
 
 #include "Arduino.h"
 
@@ -26,6 +30,7 @@
 #include "BLEDescriptor.h"
 #include "BLEUtil.h"
 #include "BLEUuid.h"
+#include "BLEVendorUuidTable.h"
 #include "nRF51822.h"
 
 
@@ -46,6 +51,17 @@ uint32_t sd_ble_gatts_value_set(uint16_t handle, uint16_t offset, uint16_t* cons
 
 #define ATTRIBUTE_TABLE_SIZE		BLE_GATTS_ATTR_TAB_SIZE_MIN * 2
 
+#if defined(NRF5) || defined(NRF51_S130)
+// the central asks for our keys again with the EDIV and RAND handed out when bonding
+static unsigned long bondKey(const ble_gap_master_id_t& masterId) {
+	return masterId.ediv | ((unsigned long)masterId.rand[0] << 16) | ((unsigned long)masterId.rand[1] << 24);
+}
+#else
+static unsigned long bondKey(uint16_t div) {
+	return div;
+}
+#endif
+
 nRF51822::nRF51822() :
 	BLEDevice(),
 
@@ -148,7 +164,7 @@ void nRF51822::begin(unsigned char advertisementDataSize,
 
 	enableParams.common_enable_params.p_conn_bw_counts = &global_conn_cfg;
 
-	enableParams.common_enable_params.vs_uuid_count = 5;
+	enableParams.common_enable_params.vs_uuid_count = BLE_VS_UUID_COUNT;
 	enableParams.gatts_enable_params.attr_tab_size = ATTRIBUTE_TABLE_SIZE;
 	enableParams.gatts_enable_params.service_changed = 1;
 	enableParams.gap_enable_params.periph_conn_count = 1;
@@ -194,6 +210,9 @@ void nRF51822::begin(unsigned char advertisementDataSize,
 	sd_ble_enable(&enableParams);
 #endif
 
+	// the SoftDevice starts out with an empty vendor specific UUID table
+	BLEVendorUuidTable::reset();
+
 #ifdef NRF_51822_DEBUG
 	ble_version_t version;
 
@@ -265,14 +284,24 @@ void nRF51822::begin(unsigned char advertisementDataSize,
 		}
 	}
 
-	this->_numLocalCharacteristics -= 3; // 0x2a00, 0x2a01, 0x2a05
+	if (numLocalAttributes > 0) {
+		this->_numLocalCharacteristics -= 3; // 0x2a00, 0x2a01, 0x2a05
+	}
 
-	this->_localCharacteristicInfo = (struct localCharacteristicInfo*)malloc(sizeof(struct localCharacteristicInfo) * this->_numLocalCharacteristics);
+	this->_localCharacteristicInfo = (struct localCharacteristicInfo*)this->allocate(sizeof(struct localCharacteristicInfo) * this->_numLocalCharacteristics);
+	if (this->_numLocalCharacteristics && this->_localCharacteristicInfo == NULL) {
+#ifdef NRF_51822_DEBUG
+		Serial.println(F("Out of memory for characteristic info, starting without attributes"));
+#endif
+		this->_numLocalCharacteristics = 0;
+		numLocalAttributes = 0;
+	}
 
 	unsigned char localCharacteristicIndex = 0;
 
 	uint16_t handle = 0;
 	BLEService* lastService = NULL;
+	uint16_t lastServiceUuid = 0;
 
 	for (int i = 0; i < numLocalAttributes; i++) {
 		BLELocalAttribute* localAttribute = localAttributes[i];
@@ -280,51 +309,35 @@ void nRF51822::begin(unsigned char advertisementDataSize,
 		const unsigned char* uuidData = uuid.data();
 		unsigned char value[255];
 
-		ble_uuid_t nordicUUID;
-
-		if (uuid.length() == 2) {
-			nordicUUID.uuid = (uuidData[1] << 8) | uuidData[0];
-			nordicUUID.type = BLE_UUID_TYPE_BLE;
-		}
-		else {
-			unsigned char uuidDataTemp[16];
-
-			memcpy(&uuidDataTemp, uuidData, sizeof(uuidDataTemp));
-
-			nordicUUID.uuid = (uuidData[13] << 8) | uuidData[12];
-
-			uuidDataTemp[13] = 0;
-			uuidDataTemp[12] = 0;
-
-			sd_ble_uuid_vs_add((ble_uuid128_t*)&uuidDataTemp, &nordicUUID.type);
-		}
+		ble_uuid_t nordicUUID = uuid.get_nordic_uuid();
 
 		if (localAttribute->type() == BLETypeService) {
 			BLEService* service = (BLEService*)localAttribute;
 
-			if (strcmp(service->uuid(), "1800") == 0 || strcmp(service->uuid(), "1801") == 0) {
+			if (nordicUUID.type == BLE_UUID_TYPE_BLE && (nordicUUID.uuid == 0x1800 || nordicUUID.uuid == 0x1801)) {
 				continue; // skip
 			}
 
 			sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &nordicUUID, &handle);
 
 			lastService = service;
+			lastServiceUuid = (uuidData[1] << 8) | uuidData[0];
 		}
 		else if (localAttribute->type() == BLETypeCharacteristic) {
 			BLECharacteristic* characteristic = (BLECharacteristic*)localAttribute;
 
-			if (strcmp(characteristic->uuid(), "2a00") == 0) {
+			if (nordicUUID.type == BLE_UUID_TYPE_BLE && nordicUUID.uuid == 0x2a00) {
 				ble_gap_conn_sec_mode_t secMode;
 				BLE_GAP_CONN_SEC_MODE_SET_OPEN(&secMode); // no security is needed
 
 				sd_ble_gap_device_name_set(&secMode, characteristic->value(), characteristic->valueLength());
 			}
-			else if (strcmp(characteristic->uuid(), "2a01") == 0) {
+			else if (nordicUUID.type == BLE_UUID_TYPE_BLE && nordicUUID.uuid == 0x2a01) {
 				const uint16_t* appearance = (const uint16_t*)characteristic->value();
 
 				sd_ble_gap_appearance_set(*appearance);
 			}
-			else if (strcmp(characteristic->uuid(), "2a05") == 0) {
+			else if (nordicUUID.type == BLE_UUID_TYPE_BLE && nordicUUID.uuid == 0x2a05) {
 				// do nothing
 			}
 			else {
@@ -335,6 +348,7 @@ void nRF51822::begin(unsigned char advertisementDataSize,
 				this->_localCharacteristicInfo[localCharacteristicIndex].notifySubscribed = false;
 				this->_localCharacteristicInfo[localCharacteristicIndex].indicateSubscribed = false;
 				this->_localCharacteristicInfo[localCharacteristicIndex].service = lastService;
+				this->_localCharacteristicInfo[localCharacteristicIndex].serviceUuid = lastServiceUuid;
 
 				ble_gatts_char_md_t characteristicMetaData;
 				ble_gatts_attr_md_t clientCharacteristicConfigurationMetaData;
@@ -382,7 +396,7 @@ void nRF51822::begin(unsigned char advertisementDataSize,
 					}
 				}
 
-				characteristicValueAttributeMetaData.vloc = BLE_GATTS_VLOC_STACK;
+				characteristicValueAttributeMetaData.vloc = characteristic->userLocated() ? BLE_GATTS_VLOC_USER : BLE_GATTS_VLOC_STACK;
 				characteristicValueAttributeMetaData.rd_auth = 0;
 				characteristicValueAttributeMetaData.wr_auth = 0;
 				characteristicValueAttributeMetaData.vlen = !characteristic->fixedLength();
@@ -413,11 +427,11 @@ void nRF51822::begin(unsigned char advertisementDataSize,
 				characteristicValueAttribute.init_len = valueLength;
 				characteristicValueAttribute.init_offs = 0;
 				characteristicValueAttribute.max_len = characteristic->valueSize();
-				characteristicValueAttribute.p_value = NULL;
+				characteristicValueAttribute.p_value = characteristic->userLocated() ? (uint8_t*)characteristic->value() : NULL;
 
 				sd_ble_gatts_characteristic_add(BLE_GATT_HANDLE_INVALID, &characteristicMetaData, &characteristicValueAttribute, &this->_localCharacteristicInfo[localCharacteristicIndex].handles);
 
-				if (valueLength) {
+				if (valueLength && !characteristic->userLocated()) {
 					for (int j = 0; j < valueLength; j++) {
 						value[j] = (*characteristic)[j];
 					}
@@ -431,10 +445,7 @@ void nRF51822::begin(unsigned char advertisementDataSize,
 		else if (localAttribute->type() == BLETypeDescriptor) {
 			BLEDescriptor* descriptor = (BLEDescriptor*)localAttribute;
 
-			if (strcmp(descriptor->uuid(), "2901") == 0 ||
-				strcmp(descriptor->uuid(), "2902") == 0 ||
-				strcmp(descriptor->uuid(), "2903") == 0 ||
-				strcmp(descriptor->uuid(), "2904") == 0) {
+			if (nordicUUID.type == BLE_UUID_TYPE_BLE && nordicUUID.uuid >= 0x2901 && nordicUUID.uuid <= 0x2904) {
 				continue; // skip
 			}
 
@@ -489,8 +500,18 @@ void nRF51822::begin(unsigned char advertisementDataSize,
 		}
 	}
 
-	this->_remoteServiceInfo = (struct remoteServiceInfo*)malloc(sizeof(struct remoteServiceInfo) * this->_numRemoteServices);
-	this->_remoteCharacteristicInfo = (struct remoteCharacteristicInfo*)malloc(sizeof(struct remoteCharacteristicInfo) * this->_numRemoteCharacteristics);
+	this->_remoteServiceInfo = (struct remoteServiceInfo*)this->allocate(sizeof(struct remoteServiceInfo) * this->_numRemoteServices);
+	this->_remoteCharacteristicInfo = (struct remoteCharacteristicInfo*)this->allocate(sizeof(struct remoteCharacteristicInfo) * this->_numRemoteCharacteristics);
+	if ((this->_numRemoteServices && this->_remoteServiceInfo == NULL) ||
+		(this->_numRemoteCharacteristics && this->_remoteCharacteristicInfo == NULL)) {
+#ifdef NRF_51822_DEBUG
+		Serial.println(F("Out of memory for remote attribute info, starting without remote attributes"));
+#endif
+		// what was allocated is released by end()
+		this->_numRemoteServices = 0;
+		this->_numRemoteCharacteristics = 0;
+		numRemoteAttributes = 0;
+	}
 
 	BLERemoteService* lastRemoteService = NULL;
 	unsigned char remoteServiceIndex = 0;
@@ -499,26 +520,8 @@ void nRF51822::begin(unsigned char advertisementDataSize,
 	for (int i = 0; i < numRemoteAttributes; i++) {
 		BLERemoteAttribute* remoteAttribute = remoteAttributes[i];
 		BLEUuid uuid = BLEUuid(remoteAttribute->uuid());
-		const unsigned char* uuidData = uuid.data();
-
-		ble_uuid_t nordicUUID;
-
-		if (uuid.length() == 2) {
-			nordicUUID.uuid = (uuidData[1] << 8) | uuidData[0];
-			nordicUUID.type = BLE_UUID_TYPE_BLE;
-		}
-		else {
-			unsigned char uuidDataTemp[16];
-
-			memcpy(&uuidDataTemp, uuidData, sizeof(uuidDataTemp));
 
-			nordicUUID.uuid = (uuidData[13] << 8) | uuidData[12];
-
-			uuidDataTemp[13] = 0;
-			uuidDataTemp[12] = 0;
-
-			sd_ble_uuid_vs_add((ble_uuid128_t*)&uuidDataTemp, &nordicUUID.type);
-		}
+		ble_uuid_t nordicUUID = uuid.get_nordic_uuid();
 
 		if (remoteAttribute->type() == BLETypeService) {
 			this->_remoteServiceInfo[remoteServiceIndex].service = lastRemoteService = (BLERemoteService*)remoteAttribute;
@@ -540,15 +543,18 @@ void nRF51822::begin(unsigned char advertisementDataSize,
 		}
 	}
 
-	if (this->_bondStore && this->_bondStore->hasData()) {
 #ifdef NRF_51822_DEBUG
-		Serial.println(F("Restoring bond data"));
-#endif
-#if defined(NRF5) || defined(NRF51_S130)
-		this->_bondStore->getData(this->_bondData, 0, sizeof(this->_bondData));
-#else
-		this->_bondStore->getData(this->_authStatusBuffer, 0, sizeof(this->_authStatusBuffer));
+	Serial.print(F("Vendor UUID bases used = "));
+	Serial.print(BLEVendorUuidTable::used());
+	Serial.print(F("/"));
+	Serial.print(BLEVendorUuidTable::capacity());
+	Serial.print(F(", failed = "));
+	Serial.println(BLEVendorUuidTable::failures());
 #endif
+
+	if (this->_bondStore) {
+		// index the bonds before a central asks for keys, repairs after a power loss run from poll
+		this->_bondStore->load();
 	}
 
 	this->startAdvertising();
@@ -564,6 +570,21 @@ void nRF51822::poll(uint32_t* evtBuf, uint16_t* evtLen) {
 
 	ble_evt_t* bleEvt = (ble_evt_t*)evtBuf;
 
+#if defined(NRF51) || defined(NRF52)
+	if (this->_bondStore) {
+		uint32_t socEvtId;
+
+		// bond store flash operations complete in the background, the sketch gets every other SoC event
+		while (sd_evt_get(&socEvtId) == NRF_SUCCESS) {
+			if (!this->_bondStore->flashEvent(socEvtId) && this->_eventListener) {
+				this->_eventListener->BLEDeviceSocEventReceived(*this, socEvtId);
+			}
+		}
+
+		this->_bondStore->processFlash();
+	}
+#endif
+
 	if (sd_ble_evt_get((uint8_t*)evtBuf, evtLen) == NRF_SUCCESS) {
 		switch (bleEvt->header.evt_id) {
 
@@ -601,6 +622,7 @@ void nRF51822::poll(uint32_t* evtBuf, uint16_t* evtLen) {
 #else
 			sd_ble_tx_buffer_count_get(&this->_txBufferCount);
 #endif
+			this->resetTxThroughput();
 
 			if (this->_eventListener) {
 				this->_eventListener->BLEDeviceConnected(*this, bleEvt->evt.gap_evt.params.connected.peer_addr.addr);
@@ -709,8 +731,8 @@ void nRF51822::poll(uint32_t* evtBuf, uint16_t* evtLen) {
 			Serial.println();
 #endif
 
-			if (this->_bondStore && !this->_bondStore->hasData()) {
-				// only allow bonding if bond store exists and there is no data
+			if (this->_bondStore) {
+				// allow bonding if bond store exists, a new central takes the place of the least recently bonded one when it is full
 
 				ble_gap_sec_params_t gapSecParams;
 
@@ -788,14 +810,30 @@ void nRF51822::poll(uint32_t* evtBuf, uint16_t* evtLen) {
 			Serial.println();
 #endif
 #if defined(NRF5) || defined(NRF51_S130)
-			if (this->_encKey->master_id.ediv == bleEvt->evt.gap_evt.params.sec_info_request.master_id.ediv) {
+			// a bond from the single bond store only exists as its migrated putData record
+			if (this->_bondStore &&
+				(this->_bondStore->getBond(bondKey(bleEvt->evt.gap_evt.params.sec_info_request.master_id), this->_bondData, sizeof(this->_bondData)) ||
+					this->_bondStore->getLegacyBond(this->_bondData, sizeof(this->_bondData))) &&
+				this->_encKey->master_id.ediv == bleEvt->evt.gap_evt.params.sec_info_request.master_id.ediv &&
+				memcmp(this->_encKey->master_id.rand, bleEvt->evt.gap_evt.params.sec_info_request.master_id.rand, sizeof(this->_encKey->master_id.rand)) == 0) {
+#ifdef NRF_51822_DEBUG
+				Serial.println(F("Restoring bond data"));
+#endif
+				// stored under its key from now on
+				this->_bondStore->putBond(bondKey(this->_encKey->master_id), this->_bondData, sizeof(this->_bondData));
+
 				sd_ble_gap_sec_info_reply(this->_connectionHandle, &this->_encKey->enc_info, NULL, NULL);
 			}
 			else {
 				sd_ble_gap_sec_info_reply(this->_connectionHandle, NULL, NULL, NULL);
 			}
 #else
-			if (this->_authStatus->periph_keys.enc_info.div == bleEvt->evt.gap_evt.params.sec_info_request.div) {
+			if (this->_bondStore &&
+				(this->_bondStore->getBond(bondKey(bleEvt->evt.gap_evt.params.sec_info_request.div), this->_authStatusBuffer, sizeof(this->_authStatusBuffer)) ||
+					this->_bondStore->getLegacyBond(this->_authStatusBuffer, sizeof(this->_authStatusBuffer))) &&
+				this->_authStatus->periph_keys.enc_info.div == bleEvt->evt.gap_evt.params.sec_info_request.div) {
+				this->_bondStore->putBond(bondKey(this->_authStatus->periph_keys.enc_info.div), this->_authStatusBuffer, sizeof(this->_authStatusBuffer));
+
 				sd_ble_gap_sec_info_reply(this->_connectionHandle, &this->_authStatus->periph_keys.enc_info, NULL);
 			}
 			else {
@@ -822,9 +860,9 @@ void nRF51822::poll(uint32_t* evtBuf, uint16_t* evtLen) {
 					Serial.println(F("Storing bond data"));
 #endif
 #if defined(NRF5) || defined(NRF51_S130)
-					this->_bondStore->putData(this->_bondData, 0, sizeof(this->_bondData));
+					this->_bondStore->putBond(bondKey(this->_encKey->master_id), this->_bondData, sizeof(this->_bondData));
 #else
-					this->_bondStore->putData(this->_authStatusBuffer, 0, sizeof(this->_authStatusBuffer));
+					this->_bondStore->putBond(bondKey(this->_authStatus->periph_keys.enc_info.div), this->_authStatusBuffer, sizeof(this->_authStatusBuffer));
 #endif
 				}
 
@@ -1127,17 +1165,14 @@ void nRF51822::poll(uint32_t* evtBuf, uint16_t* evtLen) {
 void nRF51822::end() {
 	sd_softdevice_disable();
 
-	if (this->_remoteCharacteristicInfo) {
-		free(this->_remoteCharacteristicInfo);
-	}
+	this->deallocate(this->_remoteCharacteristicInfo);
+	this->_remoteCharacteristicInfo = NULL;
 
-	if (this->_remoteServiceInfo) {
-		free(this->_remoteServiceInfo);
-	}
+	this->deallocate(this->_remoteServiceInfo);
+	this->_remoteServiceInfo = NULL;
 
-	if (this->_localCharacteristicInfo) {
-		free(this->_localCharacteristicInfo);
-	}
+	this->deallocate(this->_localCharacteristicInfo);
+	this->_localCharacteristicInfo = NULL;
 
 	this->_numLocalCharacteristics = 0;
 	this->_numRemoteServices = 0;
@@ -1157,7 +1192,10 @@ bool nRF51822::updateCharacteristicValue(BLECharacteristic& characteristic) {
 
 			uint16_t valueLength = characteristic.valueLength();
 
-			sd_ble_gatts_value_set(localCharacteristicInfo->handles.value_handle, 0, &valueLength, characteristic.value());
+			// user located values are read in place, only the length of variable length values needs updating
+			if (!characteristic.userLocated() || !characteristic.fixedLength()) {
+				sd_ble_gatts_value_set(localCharacteristicInfo->handles.value_handle, 0, &valueLength, characteristic.value());
+			}
 
 			ble_gatts_hvx_params_t hvxParams;
 
@@ -1174,7 +1212,9 @@ bool nRF51822::updateCharacteristicValue(BLECharacteristic& characteristic) {
 
 					hvxParams.type = BLE_GATT_HVX_NOTIFICATION;
 
-					sd_ble_gatts_hvx(this->_connectionHandle, &hvxParams);
+					if (sd_ble_gatts_hvx(this->_connectionHandle, &hvxParams) == NRF_SUCCESS) {
+						this->addTxBytes(valueLength);
+					}
 				}
 				else {
 					success = false;
@@ -1187,7 +1227,9 @@ bool nRF51822::updateCharacteristicValue(BLECharacteristic& characteristic) {
 
 					hvxParams.type = BLE_GATT_HVX_INDICATION;
 
-					sd_ble_gatts_hvx(this->_connectionHandle, &hvxParams);
+					if (sd_ble_gatts_hvx(this->_connectionHandle, &hvxParams) == NRF_SUCCESS) {
+						this->addTxBytes(valueLength);
+					}
 				}
 				else {
 					success = false;
@@ -1216,12 +1258,10 @@ bool nRF51822::broadcastCharacteristic(BLECharacteristic& characteristic) {
 				advDataLen += (4 + characteristic.valueLength());
 
 				if (advDataLen <= 31) {
-					BLEUuid uuid = BLEUuid(localCharacteristicInfo->service->uuid());
-
 					advData[this->_advDataLen + 0] = 3 + characteristic.valueLength();
 					advData[this->_advDataLen + 1] = 0x16;
-
-					memcpy(&advData[this->_advDataLen + 2], uuid.data(), 2);
+					advData[this->_advDataLen + 2] = localCharacteristicInfo->serviceUuid & 0xff;
+					advData[this->_advDataLen + 3] = localCharacteristicInfo->serviceUuid >> 8;
 					memcpy(&advData[this->_advDataLen + 4], characteristic.value(), characteristic.valueLength());
 
 					sd_ble_gap_adv_data_set(advData, advDataLen, NULL, 0); // update advertisement data
@@ -23,10 +23,19 @@ class nRF51822 : public BLEDevice
 {
   friend class BLEPeripheral;
 
+  public:
+    // static storage needed for the info tables, counts include the built-in attributes
+    static constexpr size_t storageSize(unsigned char numLocalCharacteristics, unsigned char numRemoteAttributes) {
+      return BLE_ARENA_ALIGN(sizeof(struct localCharacteristicInfo) * (numLocalCharacteristics - 3)) +
+              BLE_ARENA_ALIGN(sizeof(struct remoteServiceInfo) * (numRemoteAttributes - 2)) +
+              BLE_ARENA_ALIGN(sizeof(struct remoteCharacteristicInfo) * (numRemoteAttributes - 2));
+    }
+
   protected:
     struct localCharacteristicInfo {
       BLECharacteristic* characteristic;
       BLEService* service;
+      uint16_t serviceUuid;
 
       ble_gatts_char_handles_t handles;
       bool notifySubscribed;
@@ -104,6 +104,55 @@ uint16_t crc_16_ccitt(uint16_t crc, uint8_t * data_in, uint16_t data_len) {
   return crc;
 }
 
+#define SETUP_FINGERPRINT_MAGIC                 0x8001
+#define SETUP_RESUME_TIMEOUT                    250
+#define SETUP_MAX_RETRIES                       3
+
+#define PENDING_REQUEST_ADDRESS                 0x01
+#define PENDING_REQUEST_TEMPERATURE             0x02
+#define PENDING_REQUEST_BATTERY_LEVEL           0x04
+
+#if defined (__AVR__)
+/* Kept out of .data/.bss so it survives an MCU reset, as does the setup held in the nRF8001's RAM */
+/* magic, setup CRC and the data credits the nRF8001 reported, no device started event follows a resume */
+static unsigned short setupFingerprint[3] __attribute__ ((section (".noinit")));
+#endif
+
+static bool setupFingerprintMatches(unsigned short crc) {
+#if defined (__AVR__)
+  return (setupFingerprint[0] == SETUP_FINGERPRINT_MAGIC && setupFingerprint[1] == crc);
+#else
+  crc = crc;
+
+  return false;
+#endif
+}
+
+static unsigned char setupFingerprintCredits() {
+#if defined (__AVR__)
+  return setupFingerprint[2];
+#else
+  return 0;
+#endif
+}
+
+static void storeSetupFingerprint(unsigned short crc, unsigned char credits) {
+#if defined (__AVR__)
+  setupFingerprint[0] = SETUP_FINGERPRINT_MAGIC;
+  setupFingerprint[1] = crc;
+  setupFingerprint[2] = credits;
+#else
+  crc = crc;
+  credits = credits;
+#endif
+}
+
+static void clearSetupFingerprint() {
+#if defined (__AVR__)
+  setupFingerprint[0] = 0;
+#endif
+}
+
 nRF8001::nRF8001(unsigned char req, unsigned char rdy, unsigned char rst) :
   BLEDevice(),
 
@@ -117,12 +166,44 @@ nRF8001::nRF8001(unsigned char req, unsigned char rdy, unsigned char rst) :
   _remotePipeInfo(NULL),
   _numRemotePipeInfo(0),
 
+  _pipeInfoIndex(NULL),
+  _numPipeInfoIndex(0),
+
   _dynamicDataOffset(0),
   _dynamicDataSequenceNo(0),
   _storeDynamicData(false),
 
-  _crcSeed(0xFFFF)
+  _localAttributes(NULL),
+  _numLocalAttributes(0),
+  _remoteAttributes(NULL),
+  _numRemoteAttributes(0),
+  _numRemoteServices(0),
+  _numLocalPipedCharacteristics(0),
+  _numRemotePipedCharacteristics(0),
+  _numPipes(0),
+  _numCustomUuids(0),
+
+  _crcSeed(0xFFFF),
+  _setupDryRun(false),
+  _setupState(SetupIdle),
+  _setupStateTime(0),
+  _numSetupMsgs(0),
+  _setupMsgIndex(0),
+  _setupMsgsQueued(0),
+  _setupMsgsAcked(0),
+  _setupRetries(0),
+  _syncValues(false),
+  _pendingRequests(0),
+
+  _numTxData(0),
+
+  _powerState(BLEPowerStandby),
+  _powerStateStartTime(0),
+  _lastActivityTime(0),
+  _wakingUp(false)
 {
+  memset(this->_powerStateTimes, 0, sizeof(this->_powerStateTimes));
+
   this->_aciState.aci_pins.reqn_pin               = req;
   this->_aciState.aci_pins.rdyn_pin               = rdy;
 
@@ -155,8 +236,6 @@ void nRF8001::begin(unsigned char advertisementDataSize,
   unsigned char numLocalPipedCharacteristics = 0;
   unsigned char numLocalPipes = 0;
 
-  this->_crcSeed = 0xFFFF;
-
   for (int i = 0; i < numLocalAttributes; i++) {
     BLELocalAttribute* localAttribute = localAttributes[i];
 
@@ -194,7 +273,7 @@ void nRF8001::begin(unsigned char advertisementDataSize,
     }
   }
 
-  this->_localPipeInfo = (struct localPipeInfo*)malloc(sizeof(struct localPipeInfo) * numLocalPipedCharacteristics);
+  this->_localPipeInfo = (struct localPipeInfo*)this->allocate(sizeof(struct localPipeInfo) * numLocalPipedCharacteristics);
 
   unsigned char numRemoteServices = 0;
   unsigned char numRemotePipedCharacteristics = 0;
@@ -242,9 +321,33 @@ void nRF8001::begin(unsigned char advertisementDataSize,
     }
   }
 
-  this->_remotePipeInfo = (struct remotePipeInfo*)malloc(sizeof(struct remotePipeInfo) * numRemotePipedCharacteristics);
+  this->_remotePipeInfo = (struct remotePipeInfo*)this->allocate(sizeof(struct remotePipeInfo) * numRemotePipedCharacteristics);
 
-  lib_aci_init(&this->_aciState, false);
+  this->_numPipeInfoIndex = numLocalPipes + numRemotePipes + 1;
+  this->_pipeInfoIndex = (unsigned char*)this->allocate(this->_numPipeInfoIndex);
+  if (this->_pipeInfoIndex == NULL) {
+    this->_numPipeInfoIndex = 0;
+  }
+
+  if ((numLocalPipedCharacteristics && this->_localPipeInfo == NULL) ||
+      (numRemotePipedCharacteristics && this->_remotePipeInfo == NULL) ||
+      this->_pipeInfoIndex == NULL) {
+#ifdef NRF_8001_DEBUG
+    Serial.println(F("Out of memory for pipe info, starting without attributes"));
+#endif
+    // what was allocated is released by end()
+    numLocalAttributes = 0;
+    numRemoteAttributes = 0;
+
+    numLocalPipedCharacteristics = 0;
+    numLocalPipes = 0;
+    numRemoteServices = 0;
+    numRemotePipedCharacteristics = 0;
+    numRemotePipes = 0;
+    numCustomUuids = 0;
+
+    this->_numPipeInfoIndex = 0;
+  }
 
   if (this->_bondStore) {
     this->_aciState.bonded = ACI_BOND_STATUS_FAILED;
@@ -252,26 +355,157 @@ void nRF8001::begin(unsigned char advertisementDataSize,
     this->_storeDynamicData = false;
   }
 
-  this->waitForSetupMode();
+  this->_localAttributes               = localAttributes;
+  this->_numLocalAttributes            = numLocalAttributes;
+  this->_remoteAttributes              = remoteAttributes;
+  this->_numRemoteAttributes           = numRemoteAttributes;
+
+  this->_numRemoteServices             = numRemoteServices;
+  this->_numLocalPipedCharacteristics  = numLocalPipedCharacteristics;
+  this->_numRemotePipedCharacteristics = numRemotePipedCharacteristics;
+  this->_numPipes                      = (numLocalPipes + numRemotePipes);
+  this->_numCustomUuids                = numCustomUuids;
+
+  // the EIR data lives on the caller's stack, but setup messages are generated until the upload completes
+  this->_advertisementData.length = 0;
+  if (advertisementDataSize && advertisementData) {
+    memcpy(&this->_advertisementData, &advertisementData[0], sizeof(BLEEirData));
+  }
+
+  this->_scanData.length = 0;
+  if (scanDataSize && scanData) {
+    memcpy(&this->_scanData, &scanData[0], sizeof(BLEEirData));
+  }
+
+  // build the setup without sending it, its CRC fingerprints the GATT image
+  this->_crcSeed = 0xFFFF;
+  this->resetSetupCursor();
+  this->_setupDryRun = true;
+  this->sendSetupMessages();
+  this->_setupDryRun = false;
+
+  this->_numSetupMsgs = this->_setupMsgIndex;
+  this->_setupRetries = 0;
+
+  // the dry run assigned the pipes
+  this->indexPipes();
+
+  if (setupFingerprintMatches(this->_crcSeed)) {
+    this->resumeSetup();
+  } else {
+    this->resetForSetup();
+  }
+}
+
+void nRF8001::sendSetupMessages()
+{
+  struct setupCursor* cursor = &this->_setupCursor;
+
+  // carry on from the message the last pass stopped at, a message is only generated again when the
+  // ACI queue filled up part way through its attribute
+  this->_setupMsgIndex = cursor->msgIndex;
+
+  while (cursor->section != SetupSectionDone) {
+    bool sent = false;
+
+    switch (cursor->section) {
+      case SetupSectionBase:
+        sent = this->sendBaseSetupMessages();
+        break;
+
+      case SetupSectionGatt:
+        sent = this->sendGattSetupMessages();
+        break;
+
+      case SetupSectionRemoteServices:
+        sent = this->sendRemoteServiceSetupMessages();
+        break;
+
+      case SetupSectionLocalPipes:
+        sent = this->sendLocalPipeSetupMessages();
+        break;
+
+      case SetupSectionRemotePipes:
+        sent = this->sendRemotePipeSetupMessages();
+        break;
+
+      case SetupSectionCustomUuids:
+        sent = this->sendCustomUuidSetupMessages();
+        break;
+
+      case SetupSectionCrc:
+        sent = this->sendCrcSetupMessage();
+        break;
+    }
+
+    if (!sent) {
+      return; // ACI queue full
+    }
+
+    if (cursor->section != SetupSectionLocalPipes) {
+      cursor->offset = 0;
+    }
+
+    cursor->section++;
+    cursor->index = 0;
+  }
+}
+
+void nRF8001::resetSetupCursor()
+{
+  memset(&this->_setupCursor, 0, sizeof(this->_setupCursor));
+
+  this->_setupCursor.section         = SetupSectionBase;
+  this->_setupCursor.handle          = 1;
+  this->_setupCursor.pipe            = 1;
+  this->_setupCursor.customUuidIndex = 2;
+}
+
+void nRF8001::markSetupCursor(struct setupCursor& resume, unsigned char index)
+{
+  resume = this->_setupCursor;
+  resume.index = index;
+  resume.msgIndex = this->_setupMsgIndex;
+}
+
+bool nRF8001::setupStalled(const struct setupCursor& resume)
+{
+  if (this->_setupDryRun || this->_setupMsgsQueued >= this->_setupMsgIndex) {
+    return false;
+  }
+
+  // start this attribute over on the next pass, its messages already queued are skipped
+  this->_setupCursor = resume;
+
+  return true;
+}
+
+bool nRF8001::sendBaseSetupMessages()
+{
+  BLEEirData* advertisementData = &this->_advertisementData;
+  BLEEirData* scanData = &this->_scanData;
+  struct setupCursor resume;
 
   hal_aci_data_t setupMsg;
   struct setupMsgData* setupMsgData = (struct setupMsgData*)setupMsg.buffer;
 
   setupMsg.status_byte = 0;
 
-  bool hasAdvertisementData = advertisementDataSize && advertisementData;
-  bool hasScanData          = scanDataSize && scanData;
+  bool hasAdvertisementData = (this->_advertisementData.length > 0);
+  bool hasScanData          = (this->_scanData.length > 0);
+
+  for (int i = this->_setupCursor.index; i < NB_BASE_SETUP_MESSAGES; i++) {
+    this->markSetupCursor(resume, i);
 
-  for (int i = 0; i < NB_BASE_SETUP_MESSAGES; i++) {
     int setupMsgSize = pgm_read_byte_near(&baseSetupMsgs[i].buffer[0]) + 2;
 
     memcpy_P(&setupMsg, &baseSetupMsgs[i], setupMsgSize);
 
     if (i == 1) {
-      setupMsgData->data[5] = numRemoteServices;
-      setupMsgData->data[6] = numLocalPipedCharacteristics;
-      setupMsgData->data[7] = numRemotePipedCharacteristics;
-      setupMsgData->data[8] = (numLocalPipes + numRemotePipes);
+      setupMsgData->data[5] = this->_numRemoteServices;
+      setupMsgData->data[6] = this->_numLocalPipedCharacteristics;
+      setupMsgData->data[7] = this->_numRemotePipedCharacteristics;
+      setupMsgData->data[8] = this->_numPipes;
 
       if (this->_bondStore) {
         setupMsgData->data[4] |= 0x02;
@@ -285,7 +519,7 @@ void nRF8001::begin(unsigned char advertisementDataSize,
 
       setupMsgData->data[22] |= 0x40;
 
-      setupMsgData->data[26] = numCustomUuids;
+      setupMsgData->data[26] = this->_numCustomUuids;
     } else if (i == 3) {
       if (hasAdvertisementData) {
         setupMsgData->data[16] |= 0x40;
@@ -313,16 +547,34 @@ void nRF8001::begin(unsigned char advertisementDataSize,
     }
 
     this->sendSetupMessage(&setupMsg);
+
+    if (this->setupStalled(resume)) {
+      return false;
+    }
   }
 
-  // GATT
-  unsigned short gattSetupMsgOffset = 0;
-  unsigned short handle             = 1;
-  unsigned char  pipe               = 1;
-  unsigned char  numLocalPiped      = 0;
-  unsigned char  numRemotePiped     = 0;
+  return true;
+}
+
+bool nRF8001::sendGattSetupMessages()
+{
+  BLELocalAttribute** localAttributes = this->_localAttributes;
+  unsigned char numLocalAttributes = this->_numLocalAttributes;
+  struct setupCursor resume;
+
+  hal_aci_data_t setupMsg;
+  struct setupMsgData* setupMsgData = (struct setupMsgData*)setupMsg.buffer;
+
+  setupMsg.status_byte = 0;
+
+  unsigned short& gattSetupMsgOffset = this->_setupCursor.offset;
+  unsigned short& handle             = this->_setupCursor.handle;
+  unsigned char&  pipe               = this->_setupCursor.pipe;
+  unsigned char&  numLocalPiped      = this->_setupCursor.numLocalPiped;
+
+  for (int i = this->_setupCursor.index; i < numLocalAttributes; i++) {
+    this->markSetupCursor(resume, i);
 
-  for (int i = 0; i < numLocalAttributes; i++) {
     BLELocalAttribute* localAttribute = localAttributes[i];
     unsigned short localAttributeType = localAttribute->type();
     BLEUuid uuid = BLEUuid(localAttribute->uuid());
@@ -569,10 +821,16 @@ void nRF8001::begin(unsigned char advertisementDataSize,
         valueOffset += chunkSize;
       }
     }
+
+    if (this->setupStalled(resume)) {
+      return false;
+    }
   }
 
   this->_numLocalPipeInfo = numLocalPiped;
 
+  this->markSetupCursor(resume, numLocalAttributes);
+
   // terminator
   setupMsgData->length   = 4;
 
@@ -580,10 +838,28 @@ void nRF8001::begin(unsigned char advertisementDataSize,
 
   this->sendSetupMessage(&setupMsg, 0x2, gattSetupMsgOffset);
 
-  unsigned short remoteServiceSetupMsgOffset  = 0;
-  unsigned char  customUuidIndex = 2;
+  return !this->setupStalled(resume);
+}
+
+bool nRF8001::sendRemoteServiceSetupMessages()
+{
+  BLERemoteAttribute** remoteAttributes = this->_remoteAttributes;
+  unsigned char numRemoteAttributes = this->_numRemoteAttributes;
+  struct setupCursor resume;
+
+  hal_aci_data_t setupMsg;
+  struct setupMsgData* setupMsgData = (struct setupMsgData*)setupMsg.buffer;
+
+  setupMsg.status_byte = 0;
+
+  unsigned short& remoteServiceSetupMsgOffset = this->_setupCursor.offset;
+  unsigned char&  pipe                        = this->_setupCursor.pipe;
+  unsigned char&  numRemotePiped              = this->_setupCursor.numRemotePiped;
+  unsigned char&  customUuidIndex             = this->_setupCursor.customUuidIndex;
+
+  for (int i = this->_setupCursor.index; i < numRemoteAttributes; i++) {
+    this->markSetupCursor(resume, i);
 
-  for (int i = 0; i < numRemoteAttributes; i++) {
     BLERemoteAttribute* remoteAttribute = remoteAttributes[i];
     BLEUuid uuid = BLEUuid(remoteAttribute->uuid());
     const unsigned char* uuidData = uuid.data();
@@ -660,14 +936,32 @@ void nRF8001::begin(unsigned char advertisementDataSize,
 
       this->sendSetupMessage(&setupMsg, 0x3, remoteServiceSetupMsgOffset);
     }
+
+    if (this->setupStalled(resume)) {
+      return false;
+    }
   }
 
   this->_numRemotePipeInfo = numRemotePiped;
 
-  // pipes
-  unsigned short pipeSetupMsgOffset  = 0;
+  return true;
+}
+
+bool nRF8001::sendLocalPipeSetupMessages()
+{
+  struct setupCursor resume;
+
+  hal_aci_data_t setupMsg;
+  struct setupMsgData* setupMsgData = (struct setupMsgData*)setupMsg.buffer;
+
+  setupMsg.status_byte = 0;
+
+  unsigned short& pipeSetupMsgOffset = this->_setupCursor.offset;
+  unsigned char   numLocalPiped      = this->_setupCursor.numLocalPiped;
+
+  for (int i = this->_setupCursor.index; i < numLocalPiped; i++) {
+    this->markSetupCursor(resume, i);
 
-  for (int i = 0; i < numLocalPiped; i++) {
     struct localPipeInfo localPipeInfo = this->_localPipeInfo[i];
 
     setupMsgData->length   = 13;
@@ -715,9 +1009,32 @@ void nRF8001::begin(unsigned char advertisementDataSize,
     }
 
     this->sendSetupMessage(&setupMsg, 0x4, pipeSetupMsgOffset);
+
+    if (this->setupStalled(resume)) {
+      return false;
+    }
   }
 
-  for (int i = 0; i < numRemotePiped; i++) {
+  return true;
+}
+
+bool nRF8001::sendRemotePipeSetupMessages()
+{
+  struct setupCursor resume;
+
+  hal_aci_data_t setupMsg;
+  struct setupMsgData* setupMsgData = (struct setupMsgData*)setupMsg.buffer;
+
+  setupMsg.status_byte = 0;
+
+  // follows on from the local pipes' offset
+  unsigned short& pipeSetupMsgOffset = this->_setupCursor.offset;
+  unsigned char   numRemotePiped     = this->_setupCursor.numRemotePiped;
+  unsigned char&  customUuidIndex    = this->_setupCursor.customUuidIndex;
+
+  for (int i = this->_setupCursor.index; i < numRemotePiped; i++) {
+    this->markSetupCursor(resume, i);
+
     struct remotePipeInfo remotePipeInfo = this->_remotePipeInfo[i];
 
     BLERemoteCharacteristic *remoteCharacteristic = remotePipeInfo.characteristic;
@@ -773,12 +1090,32 @@ void nRF8001::begin(unsigned char advertisementDataSize,
     }
 
     this->sendSetupMessage(&setupMsg, 0x4, pipeSetupMsgOffset);
+
+    if (this->setupStalled(resume)) {
+      return false;
+    }
   }
 
+  return true;
+}
+
+bool nRF8001::sendCustomUuidSetupMessages()
+{
+  BLERemoteAttribute** remoteAttributes = this->_remoteAttributes;
+  unsigned char numRemoteAttributes = this->_numRemoteAttributes;
+  struct setupCursor resume;
+
+  hal_aci_data_t setupMsg;
+  struct setupMsgData* setupMsgData = (struct setupMsgData*)setupMsg.buffer;
+
+  setupMsg.status_byte = 0;
+
   // custom uuid's (remote only for now)
-  unsigned short customUuidSetupMsgOffset = 0;
+  unsigned short& customUuidSetupMsgOffset = this->_setupCursor.offset;
+
+  for (int i = this->_setupCursor.index; i < numRemoteAttributes; i++) {
+    this->markSetupCursor(resume, i);
 
-  for (int i = 0; i < numRemoteAttributes; i++) {
     BLERemoteAttribute* remoteAttribute = remoteAttributes[i];
     BLEUuid uuid = BLEUuid(remoteAttribute->uuid());
     const unsigned char* uuidData = uuid.data();
@@ -791,17 +1128,45 @@ void nRF8001::begin(unsigned char advertisementDataSize,
     setupMsgData->data[13]  = 0;
 
     this->sendSetupMessage(&setupMsg, 0x5, customUuidSetupMsgOffset);
+
+    if (this->setupStalled(resume)) {
+      return false;
+    }
   }
 
-  // crc
-  unsigned short crcOffset = 0;
+  return true;
+}
+
+bool nRF8001::sendCrcSetupMessage()
+{
+  struct setupCursor resume;
+
+  hal_aci_data_t setupMsg;
+  struct setupMsgData* setupMsgData = (struct setupMsgData*)setupMsg.buffer;
+
+  setupMsg.status_byte = 0;
+
+  unsigned short& crcOffset = this->_setupCursor.offset;
+
+  this->markSetupCursor(resume, 0);
+
   setupMsgData->length   = 6;
   setupMsgData->data[0]  = 3;
 
   this->sendSetupMessage(&setupMsg, 0xf, crcOffset, true);
+
+  return !this->setupStalled(resume);
 }
 
 void nRF8001::poll() {
+  this->pollSetup();
+  this->pollPower();
+
+  if (this->_numTxData) {
+    // retry what didn't fit in the ACI queue last time
+    this->sendTxData();
+  }
+
   // We enter the if statement only when there is a ACI event available to be processed
   if (lib_aci_event_get(&this->_aciState, &this->_aciData)) {
     aci_evt_t* aciEvt = &this->_aciData.evt;
@@ -820,6 +1185,9 @@ void nRF8001::poll() {
 #ifdef NRF_8001_DEBUG
             Serial.println(F("Evt Device Started: Setup"));
 #endif
+            if (this->_setupState == SetupWaiting || this->_setupState == SetupResuming) {
+              this->startSetupUpload();
+            }
             break;
 
           case ACI_DEVICE_STANDBY:
@@ -828,23 +1196,19 @@ void nRF8001::poll() {
 #endif
             //Looking for an iPhone by sending radio advertisements
             //When an iPhone connects to us we will get an ACI_EVT_CONNECTED event from the nRF8001
+            this->setPowerState(BLEPowerStandby);
+
             if (aciEvt->params.device_started.hw_error) {
               delay(20); //Handle the HW error event correctly.
-            } else if (this->_bondStore && this->_bondStore->hasData()) {
-              this->_dynamicDataSequenceNo = 1;
-              this->_dynamicDataOffset = 0;
+            } else if (this->_wakingUp) {
+              // back from sleep, setup and bond data were kept
+              this->_wakingUp = false;
 
-              unsigned char chunkSize;
-              this->_bondStore->getData(&chunkSize, this->_dynamicDataOffset, sizeof(chunkSize));
-              this->_dynamicDataOffset++;
-
-              unsigned char chunkData[DYNAMIC_DATA_MAX_CHUNK_SIZE];
-              this->_bondStore->getData(chunkData, this->_dynamicDataOffset, chunkSize);
-              this->_dynamicDataOffset += chunkSize;
-
-              lib_aci_write_dynamic_data(this->_dynamicDataSequenceNo, chunkData, chunkSize);
-            } else {
               this->startAdvertising();
+            } else if (this->_syncValues) {
+              this->startValueSync();
+            } else {
+              this->restoreDynamicDataOrAdvertise();
             }
             break;
 
@@ -855,6 +1219,28 @@ void nRF8001::poll() {
       break; //ACI Device Started Event
 
       case ACI_EVT_CMD_RSP:
+        if (this->_setupState == SetupWaiting) {
+          // without a reset pin, the response to lib_aci_init's radio reset means the nRF8001 is ready for setup
+          this->startSetupUpload();
+          break;
+        } else if (this->_setupState == SetupResuming && aciEvt->params.cmd_rsp.cmd_opcode == ACI_CMD_RADIO_RESET) {
+          if (aciEvt->params.cmd_rsp.cmd_status == ACI_STATUS_SUCCESS) {
+            // the nRF8001 kept its setup and is now in standby, no device started event follows
+#ifdef NRF_8001_DEBUG
+            Serial.println(F("Setup unchanged, upload skipped"));
+#endif
+            this->_aciState.data_credit_total = setupFingerprintCredits();
+
+            this->startValueSync();
+          } else {
+            // the radio reset is rejected in setup mode
+            this->startSetupUpload();
+          }
+          break;
+        } else if (this->_setupState == SetupSyncing && aciEvt->params.cmd_rsp.cmd_opcode == ACI_CMD_SET_LOCAL_DATA) {
+          this->_setupMsgsAcked++;
+        }
+
         //If an ACI command response event comes with an error -> stop
         if (ACI_STATUS_SUCCESS != aciEvt->params.cmd_rsp.cmd_status &&
             ACI_STATUS_TRANSACTION_CONTINUE != aciEvt->params.cmd_rsp.cmd_status &&
@@ -868,8 +1254,44 @@ void nRF8001::poll() {
           Serial.print(F("Evt Cmd respone: Status "));
           Serial.println(aciEvt->params.cmd_rsp.cmd_status, HEX);
 #endif
+          if (aciEvt->params.cmd_rsp.cmd_opcode == ACI_CMD_SETUP) {
+            // messages queued after the rejected one fail as well, only the first starts over
+            if (this->_setupState == SetupUploading) {
+              if (this->_setupRetries < SETUP_MAX_RETRIES) {
+                this->_setupRetries++;
+
+                this->resetForSetup();
+              } else {
+#ifdef NRF_8001_DEBUG
+                Serial.println(F("Setup rejected, giving up"));
+#endif
+                this->_setupState = SetupIdle;
+              }
+            }
+          } else if (aciEvt->params.cmd_rsp.cmd_opcode == ACI_CMD_WRITE_DYNAMIC_DATA) {
+            // the stored bond doesn't fit this setup, drop it and advertise for a new one
+#ifdef NRF_8001_DEBUG
+            Serial.println(F("Dynamic data rejected, clearing bond data"));
+#endif
+            if (this->_bondStore) {
+              this->_bondStore->clearData();
+            }
+
+            this->_setupState = SetupIdle;
+
+            this->startAdvertising();
+          }
         } else {
           switch (aciEvt->params.cmd_rsp.cmd_opcode) {
+            case ACI_CMD_SETUP:
+              this->_setupMsgsAcked++;
+
+              if (aciEvt->params.cmd_rsp.cmd_status == ACI_STATUS_TRANSACTION_COMPLETE) {
+                // the nRF8001 reports standby next, the device started event moves the setup along
+                storeSetupFingerprint(this->_crcSeed, this->_aciState.data_credit_total);
+              }
+              break;
+
             case ACI_CMD_READ_DYNAMIC_DATA: {
 #ifdef NRF_8001_DEBUG
               Serial.print(F("Dynamic data read sequence "));
@@ -895,6 +1317,19 @@ void nRF8001::poll() {
               if (aciEvt->params.cmd_rsp.cmd_status == ACI_STATUS_TRANSACTION_CONTINUE) {
                 lib_aci_read_dynamic_data();
               } else if (aciEvt->params.cmd_rsp.cmd_status == ACI_STATUS_TRANSACTION_COMPLETE) {
+#ifdef NRF_8001_DEBUG
+                unsigned int dirtyStart;
+                unsigned int dirtyEnd;
+
+                if (this->_bondStore->dirtyRange(dirtyStart, dirtyEnd)) {
+                  Serial.print(F("Bond data changed: "));
+                  Serial.print(dirtyStart);
+                  Serial.print(F(" - "));
+                  Serial.println(dirtyEnd);
+                } else {
+                  Serial.println(F("Bond data unchanged"));
+                }
+#endif
                 this->startAdvertising();
               }
               break;
@@ -919,8 +1354,9 @@ void nRF8001::poll() {
 
                 lib_aci_write_dynamic_data(this->_dynamicDataSequenceNo, chunkData, chunkSize);
               } else if (aciEvt->params.cmd_rsp.cmd_status == ACI_STATUS_TRANSACTION_COMPLETE) {
-                delay(20);
-                this->startAdvertising();
+                // give the nRF8001 20 ms before advertising, see pollSetup
+                this->_setupStateTime = millis();
+                this->_setupState = SetupSettling;
               }
               break;
             }
@@ -993,6 +1429,10 @@ void nRF8001::poll() {
         }
 
         this->_aciState.data_credit_available = this->_aciState.data_credit_total;
+        this->resetTxThroughput();
+
+        this->setPowerState(BLEPowerConnected);
+        this->_lastActivityTime = millis();
         break;
 
       case ACI_EVT_PIPE_STATUS: {
@@ -1063,6 +1503,8 @@ void nRF8001::poll() {
 #ifdef NRF_8001_DEBUG
         Serial.println(F("Evt Disconnected/Advertising timed out"));
 #endif
+        this->clearTxData();
+
         // all characteristics unsubscribed on disconnect
         for (int i = 0; i < this->_numLocalPipeInfo; i++) {
           struct localPipeInfo* localPipeInfo = &this->_localPipeInfo[i];
@@ -1078,10 +1520,19 @@ void nRF8001::poll() {
           this->_eventListener->BLEDeviceDisconnected(*this);
         }
 
+        this->setPowerState(BLEPowerStandby);
+
         if (this->_storeDynamicData) {
           lib_aci_read_dynamic_data();
 
           this->_storeDynamicData = false;
+        } else if (aciEvt->params.disconnected.aci_status == ACI_STATUS_ERROR_ADVT_TIMEOUT &&
+                    this->_advertisingTimeout && lib_aci_sleep()) {
+          // nobody connected, sleep until the sleep interval is over or startAdvertising is called
+#ifdef NRF_8001_DEBUG
+          Serial.println(F("Sleeping"));
+#endif
+          this->setPowerState(BLEPowerSleep);
         } else {
           this->startAdvertising();
         }
@@ -1107,6 +1558,8 @@ void nRF8001::poll() {
       case ACI_EVT_DATA_RECEIVED: {
         uint8_t dataLen = aciEvt->len - 2;
         uint8_t pipe = aciEvt->params.data_received.rx_data.pipe_number;
+
+        this->powerActivity();
 #ifdef NRF_8001_DEBUG
         Serial.print(F("Data Received, pipe = "));
         Serial.println(aciEvt->params.data_received.rx_data.pipe_number, DEC);
@@ -1114,33 +1567,24 @@ void nRF8001::poll() {
         BLEUtil::printBuffer(aciEvt->params.data_received.rx_data.aci_data, dataLen);
 #endif
 
-        for (int i = 0; i < this->_numLocalPipeInfo; i++) {
-          struct localPipeInfo* localPipeInfo = &this->_localPipeInfo[i];
-
-          if (localPipeInfo->rxAckPipe == pipe || localPipeInfo->rxPipe == pipe) {
-            if (localPipeInfo->rxAckPipe == pipe) {
-              lib_aci_send_ack(&this->_aciState, localPipeInfo->rxAckPipe);
-            }
+        struct localPipeInfo* localPipeInfo = this->localPipeInfoForPipe(pipe);
+        struct remotePipeInfo* remotePipeInfo = this->remotePipeInfoForPipe(pipe);
 
-            if (this->_eventListener) {
-              this->_eventListener->BLEDeviceCharacteristicValueChanged(*this, *localPipeInfo->characteristic, aciEvt->params.data_received.rx_data.aci_data, dataLen);
-            }
-            break;
+        if (localPipeInfo && (localPipeInfo->rxAckPipe == pipe || localPipeInfo->rxPipe == pipe)) {
+          if (localPipeInfo->rxAckPipe == pipe) {
+            lib_aci_send_ack(&this->_aciState, localPipeInfo->rxAckPipe);
           }
-        }
-
-        for (int i = 0; i < this->_numRemotePipeInfo; i++) {
-          struct remotePipeInfo* remotePipeInfo = &this->_remotePipeInfo[i];
 
-          if (remotePipeInfo->rxPipe == pipe || remotePipeInfo->rxAckPipe == pipe || remotePipeInfo->rxReqPipe) {
-            if (remotePipeInfo->rxAckPipe == pipe) {
-             lib_aci_send_ack(&this->_aciState, remotePipeInfo->rxAckPipe);
-            }
+          if (this->_eventListener) {
+            this->_eventListener->BLEDeviceCharacteristicValueChanged(*this, *localPipeInfo->characteristic, aciEvt->params.data_received.rx_data.aci_data, dataLen);
+          }
+        } else if (remotePipeInfo && (remotePipeInfo->rxPipe == pipe || remotePipeInfo->rxAckPipe == pipe || remotePipeInfo->rxReqPipe == pipe)) {
+          if (remotePipeInfo->rxAckPipe == pipe) {
+           lib_aci_send_ack(&this->_aciState, remotePipeInfo->rxAckPipe);
+          }
 
-            if (this->_eventListener) {
-              this->_eventListener->BLEDeviceRemoteCharacteristicValueChanged(*this, *remotePipeInfo->characteristic, aciEvt->params.data_received.rx_data.aci_data, dataLen);
-            }
-            break;
+          if (this->_eventListener) {
+            this->_eventListener->BLEDeviceRemoteCharacteristicValueChanged(*this, *remotePipeInfo->characteristic, aciEvt->params.data_received.rx_data.aci_data, dataLen);
           }
         }
         break;
@@ -1148,9 +1592,23 @@ void nRF8001::poll() {
 
       case ACI_EVT_DATA_CREDIT:
         this->_aciState.data_credit_available = this->_aciState.data_credit_available + aciEvt->params.data_credit.credit;
+
+        this->sendTxData();
         break;
 
-      case ACI_EVT_PIPE_ERROR:
+      case ACI_EVT_DATA_ACK: {
+        // the central confirmed the indication, the next one for the pipe can go out
+        struct localPipeInfo* localPipeInfo = this->localPipeInfoForPipe(aciEvt->params.data_ack.pipe_number);
+
+        if (localPipeInfo) {
+          localPipeInfo->txAckInFlight = false;
+        }
+
+        this->sendTxData();
+        break;
+      }
+
+      case ACI_EVT_PIPE_ERROR: {
         //See the appendix in the nRF8001 Product Specication for details on the error codes
 #ifdef NRF_8001_DEBUG
         Serial.print(F("ACI Evt Pipe Error: Pipe #:"));
@@ -1167,7 +1625,17 @@ void nRF8001::poll() {
         } else if (this->_bondStore) {
           lib_aci_bond_request();
         }
+
+        // a failed indication won't be acked
+        struct localPipeInfo* localPipeInfo = this->localPipeInfoForPipe(aciEvt->params.pipe_error.pipe_number);
+
+        if (localPipeInfo && localPipeInfo->txAckPipe == aciEvt->params.pipe_error.pipe_number) {
+          localPipeInfo->txAckInFlight = false;
+        }
+
+        this->sendTxData();
         break;
+      }
 
       case ACI_EVT_HW_ERROR:
 #ifdef NRF_8001_DEBUG
@@ -1195,20 +1663,37 @@ void nRF8001::poll() {
 
 void nRF8001::end() {
   lib_aci_pin_reset();
+  clearSetupFingerprint();
 
-  if (this->_localPipeInfo) {
-    free(this->_localPipeInfo);
-  }
+  this->deallocate(this->_pipeInfoIndex);
+  this->_pipeInfoIndex = NULL;
+  this->_numPipeInfoIndex = 0;
 
-  if (this->_remotePipeInfo) {
-    free(this->_remotePipeInfo);
-  }
+  this->_setupState = SetupIdle;
+  this->_syncValues = false;
+  this->_pendingRequests = 0;
+  this->_numTxData = 0;
+  this->_wakingUp = false;
+  this->setPowerState(BLEPowerStandby);
+
+  this->deallocate(this->_remotePipeInfo);
+  this->_remotePipeInfo = NULL;
+
+  this->deallocate(this->_localPipeInfo);
+  this->_localPipeInfo = NULL;
 
   this->_numLocalPipeInfo = 0;
   this->_numRemotePipeInfo = 0;
 }
 
 bool nRF8001::updateCharacteristicValue(BLECharacteristic& characteristic) {
+  if (this->_setupState == SetupWaiting || this->_setupState == SetupUploading || this->_setupState == SetupResuming) {
+    // the nRF8001 can't take values yet, push them all once it reaches standby
+    this->_syncValues = true;
+
+    return false;
+  }
+
   bool success = true;
 
   struct localPipeInfo* localPipeInfo = this->localPipeInfoForCharacteristic(characteristic);
@@ -1223,22 +1708,14 @@ bool nRF8001::updateCharacteristicValue(BLECharacteristic& characteristic) {
     }
 
     if (localPipeInfo->txPipe && localPipeInfo->txPipeOpen) {
-      if (this->canNotifyCharacteristic(characteristic)) {
-        this->_aciState.data_credit_available--;
-        success &= lib_aci_send_data(localPipeInfo->txPipe, (uint8_t*)characteristic.value(), characteristic.valueLength());
-      } else {
-        success = false;
-      }
+      success &= this->queueTxData(localPipeInfo->txPipe, characteristic.value(), characteristic.valueLength());
     }
 
     if (localPipeInfo->txAckPipe && localPipeInfo->txAckPipeOpen) {
-      if (this->canIndicateCharacteristic(characteristic)) {
-        this->_aciState.data_credit_available--;
-        success &= lib_aci_send_data(localPipeInfo->txAckPipe, (uint8_t*)characteristic.value(), characteristic.valueLength());
-      } else {
-        success = false;
-      }
+      success &= this->queueTxData(localPipeInfo->txAckPipe, characteristic.value(), characteristic.valueLength());
     }
+
+    this->sendTxData();
   }
 
   return success;
@@ -1265,12 +1742,33 @@ bool nRF8001::broadcastCharacteristic(BLECharacteristic& characteristic) {
   return success;
 }
 
-bool nRF8001::canNotifyCharacteristic(BLECharacteristic& /*characteristic*/) {
-  return (this->_aciState.data_credit_available > 0);
+bool nRF8001::canNotifyCharacteristic(BLECharacteristic& characteristic) {
+  bool success = false;
+
+  struct localPipeInfo* localPipeInfo = this->localPipeInfoForCharacteristic(characteristic);
+
+  // values are queued until a data credit frees up
+  if (localPipeInfo && localPipeInfo->txPipe &&
+      (this->_powerState == BLEPowerConnected || this->_powerState == BLEPowerAppLatency)) {
+    success = lib_aci_is_pipe_available(&this->_aciState, localPipeInfo->txPipe) &&
+                (this->_numTxData < NRF_8001_TX_QUEUE_SIZE);
+  }
+
+  return success;
 }
 
-bool nRF8001::canIndicateCharacteristic(BLECharacteristic& /*characteristic*/) {
-  return (this->_aciState.data_credit_available > 0);
+bool nRF8001::canIndicateCharacteristic(BLECharacteristic& characteristic) {
+  bool success = false;
+
+  struct localPipeInfo* localPipeInfo = this->localPipeInfoForCharacteristic(characteristic);
+
+  if (localPipeInfo && localPipeInfo->txAckPipe &&
+      (this->_powerState == BLEPowerConnected || this->_powerState == BLEPowerAppLatency)) {
+    success = lib_aci_is_pipe_available(&this->_aciState, localPipeInfo->txAckPipe) &&
+                (this->_numTxData < NRF_8001_TX_QUEUE_SIZE);
+  }
+
+  return success;
 }
 
 bool nRF8001::canReadRemoteCharacteristic(BLERemoteCharacteristic& characteristic) {
@@ -1410,18 +1908,29 @@ bool nRF8001::setTxPower(int txPower) {
 }
 
 void nRF8001::startAdvertising() {
+  if (this->_powerState == BLEPowerSleep) {
+    // advertising starts once the nRF8001 is back in standby
+    if (!this->_wakingUp) {
+      this->_wakingUp = lib_aci_wakeup();
+    }
+    return;
+  }
+
   uint16_t advertisingInterval = (this->_advertisingInterval * 16) / 10;
+  uint16_t bondTimeout = (this->_advertisingTimeout && this->_advertisingTimeout < 180) ? this->_advertisingTimeout : 180;
 
   if (this->_connectable) {
     if (this->_bondStore == NULL || this->_bondStore->hasData())   {
-      lib_aci_connect(0/* in seconds, 0 means forever */, advertisingInterval);
+      lib_aci_connect(this->_advertisingTimeout/* in seconds, 0 means forever */, advertisingInterval);
     } else {
-      lib_aci_bond(180/* in seconds, 0 means forever */, advertisingInterval);
+      lib_aci_bond(bondTimeout/* in seconds, 0 means forever */, advertisingInterval);
     }
   } else {
-    lib_aci_broadcast(0/* in seconds, 0 means forever */, advertisingInterval);
+    lib_aci_broadcast(this->_advertisingTimeout/* in seconds, 0 means forever */, advertisingInterval);
   }
 
+  this->setPowerState(BLEPowerAdvertising);
+
 #ifdef NRF_8001_DEBUG
   Serial.println(F("Advertising started."));
 #endif
@@ -1432,105 +1941,197 @@ void nRF8001::disconnect() {
 }
 
 void nRF8001::requestAddress() {
-  lib_aci_get_address();
+  if (this->_setupState == SetupIdle) {
+    lib_aci_get_address();
+  } else {
+    this->_pendingRequests |= PENDING_REQUEST_ADDRESS;
+  }
 }
 
 void nRF8001::requestTemperature() {
-  lib_aci_get_temperature();
+  if (this->_setupState == SetupIdle) {
+    lib_aci_get_temperature();
+  } else {
+    this->_pendingRequests |= PENDING_REQUEST_TEMPERATURE;
+  }
 }
 
 void nRF8001::requestBatteryLevel() {
-  lib_aci_get_battery_level();
+  if (this->_setupState == SetupIdle) {
+    lib_aci_get_battery_level();
+  } else {
+    this->_pendingRequests |= PENDING_REQUEST_BATTERY_LEVEL;
+  }
 }
 
-void nRF8001::waitForSetupMode()
+void nRF8001::resetForSetup()
 {
-  bool setupMode = false;
-
-  while (!setupMode) {
-    if (lib_aci_event_get(&this->_aciState, &this->_aciData)) {
-      aci_evt_t* aciEvt = &this->_aciData.evt;
-
-      switch(aciEvt->evt_opcode) {
-        case ACI_EVT_DEVICE_STARTED: {
-          switch(aciEvt->params.device_started.device_mode) {
-            case ACI_DEVICE_SETUP:
-              /**
-              When the device is in the setup mode
-              */
-#ifdef NRF_8001_DEBUG
-              Serial.println(F("Evt Device Started: Setup"));
-#endif
-              setupMode = true;
-              break;
+  clearSetupFingerprint();
 
-            default:
-              break;
+  // pin resets the nRF8001, which starts again in setup mode
+  lib_aci_init(&this->_aciState, false);
+
+  this->_setupState = SetupWaiting;
+}
+
+void nRF8001::resumeSetup()
+{
+  unsigned char resetPin = this->_aciState.aci_pins.reset_pin;
+
+  // without a reset pin, lib_aci_init radio resets the nRF8001 instead, which keeps its setup
+  this->_aciState.aci_pins.reset_pin = UNUSED;
+  lib_aci_init(&this->_aciState, false);
+  this->_aciState.aci_pins.reset_pin = resetPin;
+
+  this->_setupStateTime = millis();
+  this->_setupState = SetupResuming;
+}
+
+void nRF8001::startSetupUpload()
+{
+  clearSetupFingerprint();
+
+  this->_crcSeed = 0xFFFF;
+  this->resetSetupCursor();
+  this->_setupMsgsQueued = 0;
+  this->_setupMsgsAcked = 0;
+
+  this->_setupState = SetupUploading;
+}
+
+void nRF8001::startValueSync()
+{
+  this->_setupMsgIndex = 0;
+  this->_setupMsgsQueued = 0;
+  this->_setupMsgsAcked = 0;
+  this->_syncValues = false;
+
+  this->_setupState = SetupSyncing;
+}
+
+void nRF8001::pollSetup()
+{
+  switch (this->_setupState) {
+    case SetupResuming:
+      if ((millis() - this->_setupStateTime) > SETUP_RESUME_TIMEOUT) {
+        // no answer, start over with a full upload
+        this->resetForSetup();
+      }
+      break;
+
+    case SetupUploading:
+      // top the ACI queue up once half of it has been answered, each pass resumes from the setup cursor
+      if (this->_setupMsgsQueued < this->_numSetupMsgs &&
+          (this->_setupMsgsQueued - this->_setupMsgsAcked) <= (ACI_QUEUE_SIZE / 2)) {
+        this->sendSetupMessages();
+      }
+      break;
+
+    case SetupSyncing:
+      // the nRF8001 holds the initial values from setup, or the previous run's after a resume
+      while (this->_setupMsgIndex < this->_numLocalPipeInfo) {
+        struct localPipeInfo* localPipeInfo = &this->_localPipeInfo[this->_setupMsgIndex];
+        BLECharacteristic* characteristic = localPipeInfo->characteristic;
+
+        if (localPipeInfo->setPipe) {
+          if (!lib_aci_set_local_data(&this->_aciState, localPipeInfo->setPipe, (uint8_t*)characteristic->value(), characteristic->valueLength())) {
+            break; // ACI queue full, retry on the next poll
           }
+
+          this->_setupMsgsQueued++;
         }
 
-        case ACI_EVT_CMD_RSP:
-          setupMode = true;
-          break;
+        this->_setupMsgIndex++;
+      }
 
-        default:
-          break;
+      if (this->_setupMsgIndex == this->_numLocalPipeInfo && this->_setupMsgsAcked >= this->_setupMsgsQueued) {
+        this->restoreDynamicDataOrAdvertise();
       }
-    } else {
-      delay(1);
-    }
+      break;
+
+    case SetupSettling:
+      if ((millis() - this->_setupStateTime) >= 20) {
+        this->_setupState = SetupIdle;
+
+        this->startAdvertising();
+      }
+      break;
+
+    case SetupIdle:
+      if (this->_pendingRequests) {
+        if (this->_pendingRequests & PENDING_REQUEST_ADDRESS) {
+          lib_aci_get_address();
+        }
+
+        if (this->_pendingRequests & PENDING_REQUEST_TEMPERATURE) {
+          lib_aci_get_temperature();
+        }
+
+        if (this->_pendingRequests & PENDING_REQUEST_BATTERY_LEVEL) {
+          lib_aci_get_battery_level();
+        }
+
+        this->_pendingRequests = 0;
+      }
+      break;
+
+    default:
+      break;
   }
 }
 
-void nRF8001::sendSetupMessage(hal_aci_data_t* data, bool withCrc)
+void nRF8001::restoreDynamicDataOrAdvertise()
 {
-  this->_crcSeed = crc_16_ccitt(this->_crcSeed, data->buffer, data->buffer[0] + (withCrc ? -1 : 1));
+  if (this->_bondStore && this->_bondStore->hasData()) {
+    this->_setupState = SetupRestoring;
 
-  if (withCrc) {
-    data->buffer[5] = (this->_crcSeed >> 8) & 0xff;
-    data->buffer[6] = this->_crcSeed & 0xff;
+    this->_dynamicDataSequenceNo = 1;
+    this->_dynamicDataOffset = 0;
+
+    unsigned char chunkSize;
+    this->_bondStore->getData(&chunkSize, this->_dynamicDataOffset, sizeof(chunkSize));
+    this->_dynamicDataOffset++;
+
+    unsigned char chunkData[DYNAMIC_DATA_MAX_CHUNK_SIZE];
+    this->_bondStore->getData(chunkData, this->_dynamicDataOffset, chunkSize);
+    this->_dynamicDataOffset += chunkSize;
+
+    lib_aci_write_dynamic_data(this->_dynamicDataSequenceNo, chunkData, chunkSize);
+  } else {
+    this->_setupState = SetupIdle;
+
+    this->startAdvertising();
   }
+}
 
-#ifdef NRF_8001_DEBUG
-  BLEUtil::printBuffer(data->buffer, data->buffer[0] + 1);
-#endif
+void nRF8001::sendSetupMessage(hal_aci_data_t* data, bool withCrc)
+{
+  unsigned short index = this->_setupMsgIndex++;
 
-  hal_aci_tl_send(data);
+  if (!this->_setupDryRun && index != this->_setupMsgsQueued) {
+    // queued by an earlier pass, or the ACI queue filled up earlier in this one
+    return;
+  }
 
-  bool setupMsgSent = false;
+  unsigned short crc = crc_16_ccitt(this->_crcSeed, data->buffer, data->buffer[0] + (withCrc ? -1 : 1));
 
-  while (!setupMsgSent) {
-    if (lib_aci_event_get(&this->_aciState, &this->_aciData)) {
-      aci_evt_t* aciEvt = &this->_aciData.evt;
+  if (withCrc) {
+    data->buffer[5] = (crc >> 8) & 0xff;
+    data->buffer[6] = crc & 0xff;
+  }
 
-      switch(aciEvt->evt_opcode) {
-        case ACI_EVT_CMD_RSP: {
-          switch(aciEvt->params.cmd_rsp.cmd_status) {
-            case ACI_STATUS_TRANSACTION_CONTINUE:
-#ifdef NRF_8001_DEBUG
-              Serial.println(F("Evt Cmd Rsp: Transaction Continue"));
-#endif
-              setupMsgSent = true;
-              break;
+  if (this->_setupDryRun) {
+    this->_crcSeed = crc;
+    return;
+  }
 
-            case ACI_STATUS_TRANSACTION_COMPLETE:
+  if (hal_aci_tl_send(data)) {
 #ifdef NRF_8001_DEBUG
-              Serial.println(F("Evt Cmd Rsp: Transaction Complete"));
+    BLEUtil::printBuffer(data->buffer, data->buffer[0] + 1);
 #endif
-              setupMsgSent = true;
-              break;
-
-            default:
-              break;
-          }
-        }
-
-        default:
-          break;
-      }
-    } else {
-      delay(1);
-    }
+    // the CRC only advances over queued messages, so the next pass can carry on from here
+    this->_crcSeed = crc;
+    this->_setupMsgsQueued++;
   }
 }
 
@@ -1546,34 +2147,194 @@ void nRF8001::sendSetupMessage(hal_aci_data_t* setupMsg, unsigned char type, uns
   offset += (setupMsgData->length - 3);
 }
 
-struct nRF8001::localPipeInfo* nRF8001::localPipeInfoForCharacteristic(BLECharacteristic& characteristic) {
-  struct localPipeInfo* result = NULL;
+void nRF8001::indexPipes() {
+  memset(this->_pipeInfoIndex, 0xff, this->_numPipeInfoIndex);
 
   for (int i = 0; i < this->_numLocalPipeInfo; i++) {
     struct localPipeInfo* localPipeInfo = &this->_localPipeInfo[i];
+    unsigned char pipes[] = {
+      localPipeInfo->advPipe, localPipeInfo->txPipe, localPipeInfo->txAckPipe,
+      localPipeInfo->rxPipe, localPipeInfo->rxAckPipe, localPipeInfo->setPipe
+    };
+
+    for (unsigned int j = 0; j < sizeof(pipes); j++) {
+      if (pipes[j] && pipes[j] < this->_numPipeInfoIndex) {
+        this->_pipeInfoIndex[pipes[j]] = i;
+      }
+    }
 
-    if (localPipeInfo->characteristic == &characteristic) {
-      result = localPipeInfo;
-      break;
+    setAttributeIndex(*localPipeInfo->characteristic, i);
+  }
+
+  for (int i = 0; i < this->_numRemotePipeInfo; i++) {
+    struct remotePipeInfo* remotePipeInfo = &this->_remotePipeInfo[i];
+    unsigned char pipes[] = {
+      remotePipeInfo->txPipe, remotePipeInfo->txAckPipe, remotePipeInfo->rxPipe,
+      remotePipeInfo->rxAckPipe, remotePipeInfo->rxReqPipe
+    };
+
+    for (unsigned int j = 0; j < sizeof(pipes); j++) {
+      if (pipes[j] && pipes[j] < this->_numPipeInfoIndex) {
+        this->_pipeInfoIndex[pipes[j]] = this->_numLocalPipeInfo + i;
+      }
     }
+
+    setAttributeIndex(*remotePipeInfo->characteristic, i);
   }
+}
 
-  return result;
+struct nRF8001::localPipeInfo* nRF8001::localPipeInfoForCharacteristic(BLECharacteristic& characteristic) {
+  unsigned char index = attributeIndex(characteristic);
+
+  // the index may have been set by another device, or the characteristic may not be ours
+  if (index < this->_numLocalPipeInfo && this->_localPipeInfo[index].characteristic == &characteristic) {
+    return &this->_localPipeInfo[index];
+  }
+
+  return NULL;
 }
 
 struct nRF8001::remotePipeInfo* nRF8001::remotePipeInfoForCharacteristic(BLERemoteCharacteristic& characteristic) {
-  struct remotePipeInfo* result = NULL;
+  unsigned char index = attributeIndex(characteristic);
 
-  for (int i = 0; i < this->_numRemotePipeInfo; i++) {
-    struct remotePipeInfo* remotePipeInfo = &this->_remotePipeInfo[i];
+  if (index < this->_numRemotePipeInfo && this->_remotePipeInfo[index].characteristic == &characteristic) {
+    return &this->_remotePipeInfo[index];
+  }
 
-    if (remotePipeInfo->characteristic == &characteristic) {
-      result = remotePipeInfo;
+  return NULL;
+}
+
+struct nRF8001::localPipeInfo* nRF8001::localPipeInfoForPipe(unsigned char pipe) {
+  if (pipe < this->_numPipeInfoIndex) {
+    unsigned char index = this->_pipeInfoIndex[pipe];
+
+    if (index < this->_numLocalPipeInfo) {
+      return &this->_localPipeInfo[index];
+    }
+  }
+
+  return NULL;
+}
+
+struct nRF8001::remotePipeInfo* nRF8001::remotePipeInfoForPipe(unsigned char pipe) {
+  if (pipe < this->_numPipeInfoIndex) {
+    unsigned char index = this->_pipeInfoIndex[pipe] - this->_numLocalPipeInfo;
+
+    if (this->_pipeInfoIndex[pipe] >= this->_numLocalPipeInfo && index < this->_numRemotePipeInfo) {
+      return &this->_remotePipeInfo[index];
+    }
+  }
+
+  return NULL;
+}
+
+bool nRF8001::queueTxData(unsigned char pipe, const unsigned char* data, unsigned char length) {
+  if (this->_numTxData >= NRF_8001_TX_QUEUE_SIZE || length > ACI_PIPE_TX_DATA_MAX_LEN) {
+    return false;
+  }
+
+  struct txData* txData = &this->_txData[this->_numTxData];
+
+  txData->pipe = pipe;
+  txData->length = length;
+  memcpy(txData->data, data, length);
+
+  this->_numTxData++;
+
+  return true;
+}
+
+void nRF8001::sendTxData() {
+  // pipes with an earlier entry still waiting, so values go out in order per pipe
+  uint64_t blockedPipes = 0;
+  unsigned char i = 0;
+
+  while (i < this->_numTxData && this->_aciState.data_credit_available > 0) {
+    struct txData* txData = &this->_txData[i];
+    uint64_t pipeMask = ((uint64_t)1) << txData->pipe;
+
+    if (!lib_aci_is_pipe_available(&this->_aciState, txData->pipe)) {
+      // unsubscribed in the meantime, drop it
+      this->_numTxData--;
+      memmove(txData, txData + 1, sizeof(struct txData) * (this->_numTxData - i));
+      continue;
+    }
+
+    struct localPipeInfo* localPipeInfo = this->localPipeInfoForPipe(txData->pipe);
+    bool indication = (localPipeInfo && localPipeInfo->txAckPipe == txData->pipe);
+
+    if ((blockedPipes & pipeMask) || (indication && localPipeInfo->txAckInFlight)) {
+      // only one indication in flight per pipe, other pipes can still use the credits
+      blockedPipes |= pipeMask;
+      i++;
+      continue;
+    }
+
+    if (!lib_aci_send_data(txData->pipe, txData->data, txData->length)) {
+      // ACI queue full, try again on the next poll
       break;
     }
+
+    this->_aciState.data_credit_available--;
+    this->addTxBytes(txData->length);
+    this->powerActivity();
+
+    if (indication) {
+      localPipeInfo->txAckInFlight = true;
+    }
+
+    this->_numTxData--;
+    memmove(txData, txData + 1, sizeof(struct txData) * (this->_numTxData - i));
+  }
+}
+
+void nRF8001::clearTxData() {
+  this->_numTxData = 0;
+
+  for (int i = 0; i < this->_numLocalPipeInfo; i++) {
+    this->_localPipeInfo[i].txAckInFlight = false;
+  }
+}
+
+unsigned long nRF8001::powerStateTime(BLEPowerState state) {
+  unsigned long time = this->_powerStateTimes[state];
+
+  if (state == this->_powerState) {
+    time += millis() - this->_powerStateStartTime;
   }
 
-  return result;
+  return time;
+}
+
+void nRF8001::pollPower() {
+  if (this->_powerState == BLEPowerSleep) {
+    if (this->_sleepInterval && (millis() - this->_powerStateStartTime) >= this->_sleepInterval) {
+      this->startAdvertising();
+    }
+  } else if (this->_powerState == BLEPowerConnected) {
+    if (this->_appLatency && (millis() - this->_lastActivityTime) >= this->_appLatencyIdleTime &&
+        lib_aci_set_app_latency(this->_appLatency, ACI_APP_LATENCY_ENABLE)) {
+      // quiet link, let the nRF8001 skip connection events
+      this->setPowerState(BLEPowerAppLatency);
+    }
+  }
+}
+
+void nRF8001::setPowerState(BLEPowerState powerState) {
+  unsigned long now = millis();
+
+  this->_powerStateTimes[this->_powerState] += now - this->_powerStateStartTime;
+
+  this->_powerState = powerState;
+  this->_powerStateStartTime = now;
+}
+
+void nRF8001::powerActivity() {
+  this->_lastActivityTime = millis();
+
+  if (this->_powerState == BLEPowerAppLatency && lib_aci_set_app_latency(0, ACI_APP_LATENCY_DISABLE)) {
+    this->setPowerState(BLEPowerConnected);
+  }
 }
 
 #endif
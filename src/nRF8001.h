@@ -10,11 +10,39 @@
 
 #include "BLEDevice.h"
 
+// notifications and indications waiting for data credits or an indication ack, 22 bytes each
+#ifndef NRF_8001_TX_QUEUE_SIZE
+#define NRF_8001_TX_QUEUE_SIZE 4
+#endif
+
 class nRF8001 : protected BLEDevice
 {
   friend class BLEPeripheral;
 
+  public:
+    // static storage needed for the pipe tables, counts include the built-in attributes
+    static constexpr size_t storageSize(unsigned char numLocalCharacteristics, unsigned char numRemoteAttributes) {
+      return BLE_ARENA_ALIGN(sizeof(struct localPipeInfo) * numLocalCharacteristics) +
+              BLE_ARENA_ALIGN(sizeof(struct remotePipeInfo) * numRemoteAttributes) +
+              BLE_ARENA_ALIGN(maxPipes(numLocalCharacteristics, numRemoteAttributes) + 1);
+    }
+
   protected:
+    // upper bound of pipes: 6 per local characteristic, 5 per remote one, 62 for the nRF8001
+    static constexpr unsigned char maxPipes(unsigned char numLocalCharacteristics, unsigned char numRemoteAttributes) {
+      return ((6 * numLocalCharacteristics + 5 * numRemoteAttributes) < 62) ? (6 * numLocalCharacteristics + 5 * numRemoteAttributes) : 62;
+    }
+
+    enum setupState {
+      SetupIdle,
+      SetupResuming,
+      SetupWaiting,
+      SetupUploading,
+      SetupSyncing,
+      SetupRestoring,
+      SetupSettling
+    };
+
     struct localPipeInfo {
       BLECharacteristic* characteristic;
 
@@ -30,6 +58,7 @@ class nRF8001 : protected BLEDevice
 
       bool               txPipeOpen;
       bool               txAckPipeOpen;
+      bool               txAckInFlight;
     };
 
     struct remotePipeInfo {
@@ -42,6 +71,37 @@ class nRF8001 : protected BLEDevice
       unsigned char             rxReqPipe;
     };
 
+    enum setupSection {
+      SetupSectionBase,
+      SetupSectionGatt,
+      SetupSectionRemoteServices,
+      SetupSectionLocalPipes,
+      SetupSectionRemotePipes,
+      SetupSectionCustomUuids,
+      SetupSectionCrc,
+      SetupSectionDone
+    };
+
+    // where the setup generator stopped, the ACI queue takes it a few messages at a time
+    struct setupCursor {
+      unsigned char      section;
+      unsigned char      index;
+      unsigned short     msgIndex;
+      unsigned short     offset;
+
+      unsigned short     handle;
+      unsigned char      pipe;
+      unsigned char      numLocalPiped;
+      unsigned char      numRemotePiped;
+      unsigned char      customUuidIndex;
+    };
+
+    struct txData {
+      unsigned char pipe;
+      unsigned char length;
+      unsigned char data[ACI_PIPE_TX_DATA_MAX_LEN];
+    };
+
     nRF8001(unsigned char req, unsigned char rdy, unsigned char rst);
 
     virtual ~nRF8001();
@@ -81,13 +141,43 @@ class nRF8001 : protected BLEDevice
     virtual void requestTemperature();
     virtual void requestBatteryLevel();
 
+    virtual unsigned long powerStateTime(BLEPowerState state);
+
   private:
-    void waitForSetupMode();
+    void resetForSetup();
+    void resumeSetup();
+    void startSetupUpload();
+    void startValueSync();
+    void pollSetup();
+    void restoreDynamicDataOrAdvertise();
+
+    void sendSetupMessages();
+    void resetSetupCursor();
+    void markSetupCursor(struct setupCursor& resume, unsigned char index);
+    bool setupStalled(const struct setupCursor& resume);
+    bool sendBaseSetupMessages();
+    bool sendGattSetupMessages();
+    bool sendRemoteServiceSetupMessages();
+    bool sendLocalPipeSetupMessages();
+    bool sendRemotePipeSetupMessages();
+    bool sendCustomUuidSetupMessages();
+    bool sendCrcSetupMessage();
     void sendSetupMessage(hal_aci_data_t* data, bool withCrc = false);
     void sendSetupMessage(hal_aci_data_t* setupMsg, unsigned char type, unsigned short& offset, bool withCrc = false);
 
+    void indexPipes();
     struct localPipeInfo* localPipeInfoForCharacteristic(BLECharacteristic& characteristic);
     struct remotePipeInfo* remotePipeInfoForCharacteristic(BLERemoteCharacteristic& characteristic);
+    struct localPipeInfo* localPipeInfoForPipe(unsigned char pipe);
+    struct remotePipeInfo* remotePipeInfoForPipe(unsigned char pipe);
+
+    bool queueTxData(unsigned char pipe, const unsigned char* data, unsigned char length);
+    void sendTxData();
+    void clearTxData();
+
+    void pollPower();
+    void setPowerState(BLEPowerState powerState);
+    void powerActivity();
 
   private:
     struct aci_state_t          _aciState;
@@ -103,11 +193,47 @@ class nRF8001 : protected BLEDevice
     struct remotePipeInfo*      _remotePipeInfo;
     unsigned char               _numRemotePipeInfo;
 
+    // pipe number -> local pipe info index, or _numLocalPipeInfo + remote pipe info index
+    unsigned char*              _pipeInfoIndex;
+    unsigned char               _numPipeInfoIndex;
+
     unsigned int                _dynamicDataOffset;
     unsigned char               _dynamicDataSequenceNo;
     bool                        _storeDynamicData;
 
+    BLELocalAttribute**         _localAttributes;
+    unsigned char               _numLocalAttributes;
+    BLERemoteAttribute**        _remoteAttributes;
+    unsigned char               _numRemoteAttributes;
+    BLEEirData                  _advertisementData;
+    BLEEirData                  _scanData;
+    unsigned char               _numRemoteServices;
+    unsigned char               _numLocalPipedCharacteristics;
+    unsigned char               _numRemotePipedCharacteristics;
+    unsigned char               _numPipes;
+    unsigned char               _numCustomUuids;
+
     unsigned short              _crcSeed;
+    bool                        _setupDryRun;
+    enum setupState             _setupState;
+    unsigned long               _setupStateTime;
+    unsigned short              _numSetupMsgs;
+    unsigned short              _setupMsgIndex;
+    unsigned short              _setupMsgsQueued;
+    unsigned short              _setupMsgsAcked;
+    struct setupCursor          _setupCursor;
+    unsigned char               _setupRetries;
+    bool                        _syncValues;
+    unsigned char               _pendingRequests;
+
+    struct txData               _txData[NRF_8001_TX_QUEUE_SIZE];
+    unsigned char               _numTxData;
+
+    BLEPowerState               _powerState;
+    unsigned long               _powerStateStartTime;
+    unsigned long               _powerStateTimes[BLE_POWER_STATES];
+    unsigned long               _lastActivityTime;
+    bool                        _wakingUp;
 };
 
 #endif
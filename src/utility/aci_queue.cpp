@@ -29,6 +29,12 @@
 #include "aci_queue.h"
 #include "ble_assert.h"
 
+/* The consumer must see a packet's data before the index that publishes it,
+   a compiler barrier is enough on the single core targets supported */
+#define ACI_QUEUE_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+#define ACI_QUEUE_INDEX(i) ((i) & (ACI_QUEUE_SIZE - 1))
+
 void aci_queue_init(aci_queue_t *aci_q)
 {
   uint8_t loop;
@@ -37,6 +43,7 @@ void aci_queue_init(aci_queue_t *aci_q)
 
   aci_q->head = 0;
   aci_q->tail = 0;
+  aci_q->high_water_mark = 0;
   for(loop=0; loop<ACI_QUEUE_SIZE; loop++)
   {
     aci_q->aci_data[loop].buffer[0] = 0x00;
@@ -46,16 +53,24 @@ void aci_queue_init(aci_queue_t *aci_q)
 
 bool aci_queue_dequeue(aci_queue_t *aci_q, hal_aci_data_t *p_data)
 {
+  uint8_t head;
+
   ble_assert(NULL != aci_q);
   ble_assert(NULL != p_data);
 
-  if (aci_queue_is_empty(aci_q))
+  head = aci_q->head;
+
+  if (head == aci_q->tail)
   {
     return false;
   }
 
-  memcpy((uint8_t *)p_data, (uint8_t *)&(aci_q->aci_data[aci_q->head % ACI_QUEUE_SIZE]), sizeof(hal_aci_data_t));
-  ++aci_q->head;
+  ACI_QUEUE_BARRIER();
+  memcpy((uint8_t *)p_data, (uint8_t *)&(aci_q->aci_data[ACI_QUEUE_INDEX(head)]), sizeof(hal_aci_data_t));
+  ACI_QUEUE_BARRIER();
+
+  /* Hand the slot back to the producer only once it has been copied out */
+  aci_q->head = head + 1;
 
   return true;
 }
@@ -63,36 +78,39 @@ bool aci_queue_dequeue(aci_queue_t *aci_q, hal_aci_data_t *p_data)
 #ifdef HAL_ACI_TL_INTERRUPT
 bool aci_queue_dequeue_from_isr(aci_queue_t *aci_q, hal_aci_data_t *p_data)
 {
-  ble_assert(NULL != aci_q);
-  ble_assert(NULL != p_data);
-
-  if (aci_queue_is_empty_from_isr(aci_q))
-  {
-    return false;
-  }
-
-  memcpy((uint8_t *)p_data, (uint8_t *)&(aci_q->aci_data[aci_q->head % ACI_QUEUE_SIZE]), sizeof(hal_aci_data_t));
-  ++aci_q->head;
-
-  return true;
+  return aci_queue_dequeue(aci_q, p_data);
 }
 #endif
 
 bool aci_queue_enqueue(aci_queue_t *aci_q, hal_aci_data_t *p_data)
 {
   const uint8_t length = p_data->buffer[0];
+  uint8_t tail;
+  uint8_t count;
 
   ble_assert(NULL != aci_q);
   ble_assert(NULL != p_data);
 
-  if (aci_queue_is_full(aci_q))
+  tail = aci_q->tail;
+  count = (uint8_t)(tail - aci_q->head);
+
+  if (count == ACI_QUEUE_SIZE)
   {
     return false;
   }
 
-  aci_q->aci_data[aci_q->tail % ACI_QUEUE_SIZE].status_byte = 0;
-  memcpy((uint8_t *)&(aci_q->aci_data[aci_q->tail % ACI_QUEUE_SIZE].buffer[0]), (uint8_t *)&p_data->buffer[0], length + 1);
-  ++aci_q->tail;
+  aci_q->aci_data[ACI_QUEUE_INDEX(tail)].status_byte = 0;
+  memcpy((uint8_t *)&(aci_q->aci_data[ACI_QUEUE_INDEX(tail)].buffer[0]), (uint8_t *)&p_data->buffer[0], length + 1);
+  ACI_QUEUE_BARRIER();
+
+  /* Publish the packet to the consumer */
+  aci_q->tail = tail + 1;
+
+  count++;
+  if (count > aci_q->high_water_mark)
+  {
+    aci_q->high_water_mark = count;
+  }
 
   return true;
 }
@@ -100,108 +118,70 @@ bool aci_queue_enqueue(aci_queue_t *aci_q, hal_aci_data_t *p_data)
 #ifdef HAL_ACI_TL_INTERRUPT
 bool aci_queue_enqueue_from_isr(aci_queue_t *aci_q, hal_aci_data_t *p_data)
 {
-  const uint8_t length = p_data->buffer[0];
-
-  ble_assert(NULL != aci_q);
-  ble_assert(NULL != p_data);
-
-  if (aci_queue_is_full_from_isr(aci_q))
-  {
-    return false;
-  }
-
-  aci_q->aci_data[aci_q->tail % ACI_QUEUE_SIZE].status_byte = 0;
-  memcpy((uint8_t *)&(aci_q->aci_data[aci_q->tail % ACI_QUEUE_SIZE].buffer[0]), (uint8_t *)&p_data->buffer[0], length + 1);
-  ++aci_q->tail;
-
-  return true;
+  return aci_queue_enqueue(aci_q, p_data);
 }
 #endif
 
 bool aci_queue_is_empty(aci_queue_t *aci_q)
 {
-  bool state = false;
-
   ble_assert(NULL != aci_q);
 
-#ifdef HAL_ACI_TL_INTERRUPT
-  //Critical section
-  noInterrupts();
-#endif
-  if (aci_q->head == aci_q->tail)
-  {
-    state = true;
-  }
-#ifdef HAL_ACI_TL_INTERRUPT
-  interrupts();
-#endif
-
-  return state;
+  return (aci_q->head == aci_q->tail);
 }
 
+#ifdef HAL_ACI_TL_INTERRUPT
 bool aci_queue_is_empty_from_isr(aci_queue_t *aci_q)
 {
-  ble_assert(NULL != aci_q);
-
-  return aci_q->head == aci_q->tail;
+  return aci_queue_is_empty(aci_q);
 }
+#endif
 
 bool aci_queue_is_full(aci_queue_t *aci_q)
 {
-  bool state;
-
   ble_assert(NULL != aci_q);
 
-#ifdef HAL_ACI_TL_INTERRUPT
-  //This should be done in a critical section
-  noInterrupts();
-#endif
-
-  state = (aci_q->tail == aci_q->head + ACI_QUEUE_SIZE);
-
-#ifdef HAL_ACI_TL_INTERRUPT
-  interrupts();
-  //end
-#endif
-
-  return state;
+  return ((uint8_t)(aci_q->tail - aci_q->head) == ACI_QUEUE_SIZE);
 }
 
+#ifdef HAL_ACI_TL_INTERRUPT
 bool aci_queue_is_full_from_isr(aci_queue_t *aci_q)
 {
-  ble_assert(NULL != aci_q);
-
-  return (aci_q->tail == aci_q->head + ACI_QUEUE_SIZE);
+  return aci_queue_is_full(aci_q);
 }
+#endif
 
 bool aci_queue_peek(aci_queue_t *aci_q, hal_aci_data_t *p_data)
 {
+  uint8_t head;
+
   ble_assert(NULL != aci_q);
   ble_assert(NULL != p_data);
 
-  if (aci_queue_is_empty(aci_q))
+  head = aci_q->head;
+
+  if (head == aci_q->tail)
   {
     return false;
   }
 
-  memcpy((uint8_t *)p_data, (uint8_t *)&(aci_q->aci_data[aci_q->head % ACI_QUEUE_SIZE]), sizeof(hal_aci_data_t));
+  ACI_QUEUE_BARRIER();
+  memcpy((uint8_t *)p_data, (uint8_t *)&(aci_q->aci_data[ACI_QUEUE_INDEX(head)]), sizeof(hal_aci_data_t));
 
   return true;
 }
 
+#ifdef HAL_ACI_TL_INTERRUPT
 bool aci_queue_peek_from_isr(aci_queue_t *aci_q, hal_aci_data_t *p_data)
 {
-  ble_assert(NULL != aci_q);
-  ble_assert(NULL != p_data);
-
-  if (aci_queue_is_empty_from_isr(aci_q))
-  {
-    return false;
-  }
+  return aci_queue_peek(aci_q, p_data);
+}
+#endif
 
-  memcpy((uint8_t *)p_data, (uint8_t *)&(aci_q->aci_data[aci_q->head % ACI_QUEUE_SIZE]), sizeof(hal_aci_data_t));
+uint8_t aci_queue_high_water_mark(aci_queue_t *aci_q)
+{
+  ble_assert(NULL != aci_q);
 
-  return true;
+  return aci_q->high_water_mark;
 }
 
 #endif
@@ -38,8 +38,15 @@
 /***********************************************************************    */
 /* The ACI_QUEUE_SIZE determines the memory usage of the system.            */
 /* Successfully tested to a ACI_QUEUE_SIZE of 4 (interrupt) and 4 (polling) */
+/* It can be overridden at compile time, it must be a power of two <= 128   */
 /***********************************************************************    */
+#ifndef ACI_QUEUE_SIZE
 #define ACI_QUEUE_SIZE  4
+#endif
+
+#if (ACI_QUEUE_SIZE < 2) || (ACI_QUEUE_SIZE > 128) || ((ACI_QUEUE_SIZE & (ACI_QUEUE_SIZE - 1)) != 0)
+#error "ACI_QUEUE_SIZE must be a power of two between 2 and 128"
+#endif
 
 /** Data type for queue of data packets to send/receive from radio.
  *
@@ -47,12 +54,18 @@
  *  at the tail and taken (dequeued) from the head. The head variable is the
  *  index of the next packet to dequeue while the tail variable is the index of
  *  where the next packet should be queued.
+ *
+ *  The queue is single producer, single consumer: only the producer writes
+ *  tail and only the consumer writes head. Both indexes run freely and wrap
+ *  at 256, which the power of two size divides, so one side can be the RDYN
+ *  interrupt and the other the main loop without disabling interrupts.
  */
 
 typedef struct {
 	hal_aci_data_t           aci_data[ACI_QUEUE_SIZE];
-	uint8_t                  head;
-	uint8_t                  tail;
+	volatile uint8_t         head;
+	volatile uint8_t         tail;
+	uint8_t                  high_water_mark;
 } aci_queue_t;
 
 void aci_queue_init(aci_queue_t *aci_q);
@@ -82,5 +95,9 @@ bool aci_queue_peek(aci_queue_t *aci_q, hal_aci_data_t *p_data);
 bool aci_queue_peek_from_isr(aci_queue_t *aci_q, hal_aci_data_t *p_data);
 #endif
 
+/** Highest number of packets the queue held since it was initialized.
+ */
+uint8_t aci_queue_high_water_mark(aci_queue_t *aci_q);
+
 #endif /* ACI_QUEUE_H__ */
 /** @} */
@@ -43,12 +43,37 @@ The outgoing command and the incoming event needs to be converted
     //For Arduino add nothing
 #elif defined(__PIC32MX__)
     //For ChipKit as the transmission has to be reversed, the next definitions have to be added
-    #define REVERSE_BITS(byte) (((reverse_lookup[(byte & 0x0F)]) << 4) + reverse_lookup[((byte & 0xF0) >> 4)])
-    static const uint8_t reverse_lookup[] = { 0, 8,  4, 12, 2, 10, 6, 14,1, 9, 5, 13,3, 11, 7, 15 };
+    #define REVERSE_BITS(byte) (reverse_lookup[(uint8_t)(byte)])
+    static const uint8_t reverse_lookup[256] = {
+      0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0, 0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
+      0x08, 0x88, 0x48, 0xc8, 0x28, 0xa8, 0x68, 0xe8, 0x18, 0x98, 0x58, 0xd8, 0x38, 0xb8, 0x78, 0xf8,
+      0x04, 0x84, 0x44, 0xc4, 0x24, 0xa4, 0x64, 0xe4, 0x14, 0x94, 0x54, 0xd4, 0x34, 0xb4, 0x74, 0xf4,
+      0x0c, 0x8c, 0x4c, 0xcc, 0x2c, 0xac, 0x6c, 0xec, 0x1c, 0x9c, 0x5c, 0xdc, 0x3c, 0xbc, 0x7c, 0xfc,
+      0x02, 0x82, 0x42, 0xc2, 0x22, 0xa2, 0x62, 0xe2, 0x12, 0x92, 0x52, 0xd2, 0x32, 0xb2, 0x72, 0xf2,
+      0x0a, 0x8a, 0x4a, 0xca, 0x2a, 0xaa, 0x6a, 0xea, 0x1a, 0x9a, 0x5a, 0xda, 0x3a, 0xba, 0x7a, 0xfa,
+      0x06, 0x86, 0x46, 0xc6, 0x26, 0xa6, 0x66, 0xe6, 0x16, 0x96, 0x56, 0xd6, 0x36, 0xb6, 0x76, 0xf6,
+      0x0e, 0x8e, 0x4e, 0xce, 0x2e, 0xae, 0x6e, 0xee, 0x1e, 0x9e, 0x5e, 0xde, 0x3e, 0xbe, 0x7e, 0xfe,
+      0x01, 0x81, 0x41, 0xc1, 0x21, 0xa1, 0x61, 0xe1, 0x11, 0x91, 0x51, 0xd1, 0x31, 0xb1, 0x71, 0xf1,
+      0x09, 0x89, 0x49, 0xc9, 0x29, 0xa9, 0x69, 0xe9, 0x19, 0x99, 0x59, 0xd9, 0x39, 0xb9, 0x79, 0xf9,
+      0x05, 0x85, 0x45, 0xc5, 0x25, 0xa5, 0x65, 0xe5, 0x15, 0x95, 0x55, 0xd5, 0x35, 0xb5, 0x75, 0xf5,
+      0x0d, 0x8d, 0x4d, 0xcd, 0x2d, 0xad, 0x6d, 0xed, 0x1d, 0x9d, 0x5d, 0xdd, 0x3d, 0xbd, 0x7d, 0xfd,
+      0x03, 0x83, 0x43, 0xc3, 0x23, 0xa3, 0x63, 0xe3, 0x13, 0x93, 0x53, 0xd3, 0x33, 0xb3, 0x73, 0xf3,
+      0x0b, 0x8b, 0x4b, 0xcb, 0x2b, 0xab, 0x6b, 0xeb, 0x1b, 0x9b, 0x5b, 0xdb, 0x3b, 0xbb, 0x7b, 0xfb,
+      0x07, 0x87, 0x47, 0xc7, 0x27, 0xa7, 0x67, 0xe7, 0x17, 0x97, 0x57, 0xd7, 0x37, 0xb7, 0x77, 0xf7,
+      0x0f, 0x8f, 0x4f, 0xcf, 0x2f, 0xaf, 0x6f, 0xef, 0x1f, 0x9f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff,
+    };
 #else
     #error "Unsupported platform"
 #endif
 
+/*
+Boards whose SPI library can move a whole buffer in one call, the ACI payload that follows
+the two header bytes is clocked out with it instead of byte by byte
+*/
+#if defined(SPI_HAS_TRANSACTION) && (defined (__AVR__) || defined(__SAMD21G18A__) || defined(__MK20DX128__) || defined(__MK20DX256__) || defined(__MKL26Z64__))
+    #define HAL_ACI_TL_SPI_BUFFER_TRANSFER
+#endif
+
 #ifdef HAL_ACI_TL_DEBUG
 static void m_aci_data_print(hal_aci_data_t *p_data);
 #endif
@@ -63,6 +88,7 @@ static void m_aci_q_flush(void);
 static bool m_aci_spi_transfer(hal_aci_data_t * data_to_send, hal_aci_data_t * received_data);
 
 static uint8_t        spi_readwrite(uint8_t aci_byte);
+static void           spi_readwrite_buffer(uint8_t *buffer, uint8_t length);
 #ifdef HAL_ACI_TL_DEBUG
 static bool           aci_debug_print = false;
 #endif
@@ -72,6 +98,11 @@ aci_queue_t    aci_rx_q;
 
 static aci_pins_t	 *a_pins_local_ptr;
 
+#ifdef HAL_ACI_TL_INTERRUPT
+/* Set by the ISR when it stops taking events because the event queue is full */
+static volatile bool  m_aci_isr_detached = false;
+#endif
+
 #ifdef HAL_ACI_TL_DEBUG
 void m_aci_data_print(hal_aci_data_t *p_data)
 {
@@ -97,6 +128,14 @@ static void m_aci_isr(void)
   hal_aci_data_t data_to_send;
   hal_aci_data_t received_data;
 
+  // No room to store an incoming message, leave it in the nRF8001 until the main loop makes room
+  if (aci_queue_is_full_from_isr(&aci_rx_q))
+  {
+    detachInterrupt(a_pins_local_ptr->interrupt_number);
+    m_aci_isr_detached = true;
+    return;
+  }
+
   // Receive from queue
   if (!aci_queue_dequeue_from_isr(&aci_tx_q, &data_to_send))
   {
@@ -113,22 +152,16 @@ static void m_aci_isr(void)
     m_aci_reqn_enable();
   }
 
-  // Check if we received data
+  // Check if we received data, there is room as only this ISR adds to the event queue
   if (received_data.buffer[0] > 0)
   {
-    if (!aci_queue_enqueue_from_isr(&aci_rx_q, &received_data))
-    {
-      /* Receive Buffer full.
-         Should never happen.
-         Spin in a while loop.
-      */
-      while(1);
-    }
+    aci_queue_enqueue_from_isr(&aci_rx_q, &received_data);
 
     // Disable ready line interrupt until we have room to store incoming messages
     if (aci_queue_is_full_from_isr(&aci_rx_q))
     {
       detachInterrupt(a_pins_local_ptr->interrupt_number);
+      m_aci_isr_detached = true;
     }
   }
 
@@ -178,17 +211,10 @@ static void m_aci_event_check(void)
     m_aci_reqn_enable();
   }
 
-  // Check if we received data
+  // Check if we received data, room for it was checked before the transfer
   if (received_data.buffer[0] > 0)
   {
-    if (!aci_queue_enqueue(&aci_rx_q, &received_data))
-    {
-      /* Receive Buffer full.
-         Should never happen.
-         Spin in a while loop.
-      */
-      while(1);
-    }
+    aci_queue_enqueue(&aci_rx_q, &received_data);
   }
 
   return;
@@ -227,11 +253,20 @@ static void m_aci_q_flush(void)
   aci_queue_init(&aci_tx_q);
   aci_queue_init(&aci_rx_q);
   interrupts();
+
+#ifdef HAL_ACI_TL_INTERRUPT
+  if (m_aci_isr_detached)
+  {
+    m_aci_isr_detached = false;
+
+    /* The event queue has room again */
+    attachInterrupt(a_pins_local_ptr->interrupt_number, m_aci_isr, LOW);
+  }
+#endif
 }
 
 static bool m_aci_spi_transfer(hal_aci_data_t * data_to_send, hal_aci_data_t * received_data)
 {
-  uint8_t byte_cnt;
   uint8_t byte_sent_cnt;
   uint8_t max_bytes;
 
@@ -259,12 +294,19 @@ static bool m_aci_spi_transfer(hal_aci_data_t * data_to_send, hal_aci_data_t * r
     max_bytes = HAL_ACI_MAX_LENGTH;
   }
 
-  // Transmit/receive the rest of the packet
-  for (byte_cnt = 0; byte_cnt < max_bytes; byte_cnt++)
+  // Transmit/receive the rest of the packet in place, padding after the end of the command
+  uint8_t cmd_bytes = (data_to_send->buffer[0] > 0) ? (data_to_send->buffer[0] - 1) : 0;
+
+  if (cmd_bytes > max_bytes)
   {
-    received_data->buffer[byte_cnt+1] =  spi_readwrite(data_to_send->buffer[byte_sent_cnt++]);
+    cmd_bytes = max_bytes;
   }
 
+  memcpy(&received_data->buffer[1], &data_to_send->buffer[byte_sent_cnt], cmd_bytes);
+  memset(&received_data->buffer[1 + cmd_bytes], 0, max_bytes - cmd_bytes);
+
+  spi_readwrite_buffer(&received_data->buffer[1], max_bytes);
+
   // RDYN should follow the REQN line in approx 100ns
   m_aci_reqn_disable();
 
@@ -326,10 +368,6 @@ bool hal_aci_tl_event_peek(hal_aci_data_t *p_aci_data)
 
 bool hal_aci_tl_event_get(hal_aci_data_t *p_aci_data)
 {
-#ifdef HAL_ACI_TL_INTERRUPT
-  bool was_full;
-#endif
-
 #ifdef HAL_ACI_TL_INTERRUPT
   if (!a_pins_local_ptr->interface_is_interrupt && !aci_queue_is_full(&aci_rx_q))
 #else
@@ -339,12 +377,6 @@ bool hal_aci_tl_event_get(hal_aci_data_t *p_aci_data)
     m_aci_event_check();
   }
 
-#ifdef HAL_ACI_TL_DEBUG
-  was_full = aci_queue_is_full(&aci_rx_q);
-#else
-  aci_queue_is_full(&aci_rx_q);
-#endif
-
   if (aci_queue_dequeue(&aci_rx_q, p_aci_data))
   {
 #ifdef HAL_ACI_TL_DEBUG
@@ -356,12 +388,15 @@ bool hal_aci_tl_event_get(hal_aci_data_t *p_aci_data)
 #endif
 
 #ifdef HAL_ACI_TL_INTERRUPT
-    if (was_full && a_pins_local_ptr->interface_is_interrupt)
-	  {
+    /* The ISR stays detached until now, so it can't race the check */
+    if (m_aci_isr_detached)
+    {
+      m_aci_isr_detached = false;
+
       /* Enable RDY line interrupt again */
       attachInterrupt(a_pins_local_ptr->interrupt_number, m_aci_isr, LOW);
 #if defined(SPI_HAS_TRANSACTION) && defined(__SAMD21G18A__)
-      SPI.usingInterrupt(a_pins->interrupt_number);
+      SPI.usingInterrupt(a_pins_local_ptr->interrupt_number);
 #endif
     }
 #endif
@@ -439,6 +474,7 @@ void hal_aci_tl_init(aci_pins_t *a_pins, bool /*debug*/)
   if (a_pins->interface_is_interrupt)
   {
     // We use the LOW level of the RDYN line as the atmega328 can wakeup from sleep only on LOW
+    m_aci_isr_detached = false;
     attachInterrupt(a_pins->interrupt_number, m_aci_isr, LOW);
   }
 #endif
@@ -491,6 +527,20 @@ static uint8_t spi_readwrite(const uint8_t aci_byte)
 #endif
 }
 
+static void spi_readwrite_buffer(uint8_t *buffer, uint8_t length)
+{
+#if defined(HAL_ACI_TL_SPI_BUFFER_TRANSFER)
+  SPI.transfer(buffer, length);
+#else
+  uint8_t i;
+
+  for (i = 0; i < length; i++)
+  {
+    buffer[i] = spi_readwrite(buffer[i]);
+  }
+#endif
+}
+
 bool hal_aci_tl_rx_q_empty (void)
 {
   return aci_queue_is_empty(&aci_rx_q);
@@ -511,6 +561,16 @@ bool hal_aci_tl_tx_q_full (void)
   return aci_queue_is_full(&aci_tx_q);
 }
 
+uint8_t hal_aci_tl_rx_q_high_water_mark (void)
+{
+  return aci_queue_high_water_mark(&aci_rx_q);
+}
+
+uint8_t hal_aci_tl_tx_q_high_water_mark (void)
+{
+  return aci_queue_high_water_mark(&aci_tx_q);
+}
+
 void hal_aci_tl_q_flush (void)
 {
   m_aci_q_flush();
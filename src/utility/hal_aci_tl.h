@@ -170,6 +170,20 @@ void hal_aci_tl_pin_reset(void);
  */
  bool hal_aci_tl_tx_q_empty(void);
 
+/** @brief Return the most events the receive queue has held
+ *  @details
+ *  Reaching ACI_QUEUE_SIZE means the nRF8001 had to hold events back
+ *  until the application polled, consider a larger ACI_QUEUE_SIZE.
+ */
+uint8_t hal_aci_tl_rx_q_high_water_mark(void);
+
+/** @brief Return the most commands the transmit queue has held
+ *  @details
+ *  Reaching ACI_QUEUE_SIZE means hal_aci_tl_send refused commands
+ *  and they had to be sent again later, consider a larger ACI_QUEUE_SIZE.
+ */
+uint8_t hal_aci_tl_tx_q_high_water_mark(void);
+
 /** @brief Flush the ACI command Queue and the ACI Event Queue
  *  @details
  *  Call this function in the main thread